@@ -1,13 +1,33 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cstring>
 #include <ctime>
 #include <cctype>
-#include <conio.h> 
-#include <stdexcept>
-#include <set>
 #include <string>
-#include <windows.h>//for sleep function
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <csignal>
+#include "sort_view.h"
+#include "search_index.h"
+#include "drink_snapshot.h"
+#include "frame_renderer.h"
+#include "money.h"
+#include "cart_journal.h"
+#include "order_id.h"
+#include "order_pipeline.h"
+#include "order_log.h"
+#include "history_writer.h"
+#include "kitchen_scheduler.h"
+#include "inventory.h"
+#include "customer_store.h"
+#include "table_journal.h"
+#include "profile_store.h"
+#include "live_catalog.h"
+#include "order_service.h"
+#include "csv_parser.h"
+#include "platform.h"
 
 using namespace std;
 
@@ -16,7 +36,7 @@ struct Drink {
     int id;
     char name[50];
     char category[20];
-    float price;
+    Cents price;
     int calories;
     char iceLevel[20];
     char sweetness[20]; 
@@ -25,17 +45,134 @@ struct Drink {
     int quantity;
 };
 
-struct CartItem {
-    Drink drink;
-    CartItem* next;
+//one cart line; name and price details are looked up in the catalog by id
+struct CartLine {
+    int drinkId;
+    int priceCents;          //unit price when the line was added
+    unsigned short quantity;
+    unsigned char custom;    //ice choice in the low 4 bits, sweetness in the high 4 bits
+
+    int ice() const { return custom & 0x0F; }
+    int sweet() const { return custom >> 4; }
+};
+
+//cart as a contiguous array of lines, with the subtotal and item count kept
+//up to date on every change so they never need a walk over the cart
+class Cart {
+private:
+    vector<CartLine> lines;
+    Cents subtotal;
+    int items;
+
+    int find(int drinkId, unsigned char custom) const {
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (lines[i].drinkId == drinkId && lines[i].custom == custom) return (int)i;
+        }
+        return -1;
+    }
+
+public:
+    static unsigned char pack(int ice, int sweet) {
+        return (unsigned char)(ice | (sweet << 4));
+    }
+
+    Cart() : subtotal(0), items(0) {}
+
+    //adds qty of a drink, merged into the line with the same customization if there
+    //is one; returns the line index, or -1 if that line would go over maxQty
+    int add(int drinkId, int priceCents, int qty, int ice, int sweet, int maxQty) {
+        unsigned char custom = pack(ice, sweet);
+        int i = find(drinkId, custom);
+        if (i == -1) {
+            CartLine line;
+            line.drinkId = drinkId;
+            line.priceCents = priceCents;
+            line.quantity = 0;
+            line.custom = custom;
+            lines.push_back(line);
+            i = (int)lines.size() - 1;
+        }
+        if (lines[i].quantity + qty > maxQty) return -1;
+        setQuantity(i, lines[i].quantity + qty);
+        return i;
+    }
+
+    void setQuantity(int i, int qty) {
+        CartLine& line = lines[i];
+        subtotal += (Cents)line.priceCents * (qty - line.quantity);
+        items += qty - line.quantity;
+        line.quantity = (unsigned short)qty;
+    }
+
+    //changes a line's customization, merging it into a matching line; returns the
+    //line's new index, or -1 if the merged line would go over maxQty
+    int setCustom(int i, int ice, int sweet, int maxQty) {
+        unsigned char custom = pack(ice, sweet);
+        int j = find(lines[i].drinkId, custom);
+        if (j == -1 || j == i) {
+            lines[i].custom = custom;
+            return i;
+        }
+        if (lines[j].quantity + lines[i].quantity > maxQty) return -1;
+        setQuantity(j, lines[j].quantity + lines[i].quantity);
+        int last = (int)lines.size() - 1;
+        remove(i);
+        return j == last ? i : j;
+    }
+
+    //the last line takes the removed line's place
+    void remove(int i) {
+        subtotal -= (Cents)lines[i].priceCents * lines[i].quantity;
+        items -= lines[i].quantity;
+        lines[i] = lines.back();
+        lines.pop_back();
+    }
+
+    void clear() {
+        lines.clear();
+        subtotal = 0;
+        items = 0;
+    }
+
+    bool empty() const { return lines.empty(); }
+    int size() const { return (int)lines.size(); }
+    const CartLine& at(int i) const { return lines[i]; }
+    Cents subtotalCents() const { return subtotal; }
+    int itemCount() const { return items; }
+
+    //price and quantity columns of every line, for the batch pricing kernel
+    void priceInto(PriceBatch& batch) const {
+        batch.clear();
+        batch.reserve(lines.size());
+        for (size_t i = 0; i < lines.size(); i++) {
+            batch.add(lines[i].priceCents, lines[i].quantity);
+        }
+    }
 };
 
 struct OrderHistory {
-    int orderId; 
+    OrderId orderId; 
     time_t orderDate;
-    float totalAmount;
+    Cents totalAmount;
     int itemCount;
-    OrderHistory* next;
+};
+
+//a customer's orders, read from the order log only when they are viewed and
+//only as far back as the customer pages; rows sit in one buffer, newest first
+struct CustomerHistory {
+    vector<OrderHistory> rows;
+    int64_t nextOffset;     //log offset of the next older order, -1 when all are read
+    bool started;
+    
+    CustomerHistory() : nextOffset(-1), started(false) {}
+    
+    void reset() {
+        rows.clear();
+        nextOffset = -1;
+        started = false;
+    }
+    
+    bool complete() const { return started && nextOffset < 0; }
 };
 
 struct Customer {
@@ -43,95 +180,183 @@ struct Customer {
     char name[50];
     char email[100];
     char password[50];
-    CartItem* cart;
-    OrderHistory* orderHistory;
+    Cart cart;
+    CustomerHistory history;
     bool isGuest;        
 };
 
-//queue implementation 
+//an order on its way through payment and fulfillment
+struct OrderTicket {
+    OrderId id;
+    int customerId;         //0 for guests
+    int owner;              //cart journal owner, the items go back there if payment fails
+    Cents total;
+    int itemCount;
+    time_t placed;
+    vector<OrderLogItem> items;  //item details for the order log, names resolved on the UI thread
+    vector<CartLine> lines;
+};
+
+void appendHistoryLine(const OrderTicket& ticket);
+
+//queue implementation: orders wait here for the payment gateway and fulfillment,
+//which run on worker threads (order_pipeline.h)
 class OrderQueue {
 private:
-    struct QueueNode {
-        int orderId;
-        QueueNode* next;
-        
-        QueueNode(int id) : orderId(id), next(nullptr) {}
-    };
-    
-    QueueNode* front;
-    QueueNode* rear;
-    int count;
+    SimulatedGateway gateway;
+    OrderPipeline<OrderTicket> pipeline;
     
 public:
-    OrderQueue() : front(nullptr), rear(nullptr), count(0) {
+    OrderQueue() : pipeline(&gateway, appendHistoryLine) {
         cout<<"Order queue initialized\n";
     }
     
-    ~OrderQueue() {
-        while (front != nullptr) {
-            QueueNode* temp = front;
-            front = front->next;
-            delete temp;
-        }
+    //false when checkout is saturated, the caller keeps the order
+    bool enqueue(const OrderTicket& ticket) {
+        if (!pipeline.submit(ticket)) return false;
+        cout<<"Order #" << ticket.id << " added to queue\n";
+        return true;
     }
     
-    void enqueue(int orderId) {
-        QueueNode* newNode = new QueueNode(orderId);
-        if (rear == nullptr) {
-            front = rear = newNode;
-        } else {
-            rear->next = newNode;
-            rear = newNode;
-        }
-        count++;
-        cout<<"Order #" << orderId << " added to queue\n";
+    //next finished order, never waits
+    bool poll(OrderEvent<OrderTicket>& event) {
+        return pipeline.poll(event);
     }
     
-    int dequeue() {
-        if (front == nullptr) {
-            throw runtime_error("Queue is empty!");
-        }
-        
-        QueueNode* temp = front;
-        int orderId = front->orderId;
-        front = front->next;
-        
-        if (front == nullptr) {
-            rear = nullptr;
-        }
-        
-        delete temp;
-        count--;
-        cout<<"Processing order #" << orderId << "\n";
-        return orderId;
+    //finishes every order already submitted, then stops the workers
+    void shutdown() {
+        pipeline.shutdown();
     }
     
     bool isEmpty() {
-        return front == nullptr;
+        return pipeline.pending() == 0;
     }
     
     int size() {
-        return count;
+        return pipeline.pending();
     }
 };
 
+//drink catalog: the mapped mixue.bin snapshot and the id and category indexes stored in it.
+//slots never move, so both indexes stay valid however the menu is sorted
+class DrinkCatalog {
+private:
+    DrinkSnapshot snapshot;
+    unsigned long version;  //bumped on every reload, for cached views
+    LiveCatalog live;       //menu changes published by the admin program
+    uint64_t liveSeen;
+    
+public:
+    DrinkCatalog() : version(0), liveSeen(0) {}
+    
+    //mixue.txt at startup; later changes arrive through livePath
+    bool load(const char* csvPath, const char* binPath, const char* livePath) {
+        version++;
+        if (live.open(livePath)) liveSeen = live.sequence();
+        return snapshot.open(csvPath, binPath);
+    }
+    
+    //takes the published menu if it changed since the last look; one atomic
+    //load when it has not. slots and record pointers are invalid afterwards
+    bool refresh() {
+        if (!live.isOpen() || live.sequence() == liveSeen) return false;
+        vector<DrinkRecord> records;
+        uint64_t seq;
+        if (!live.read(records, seq)) return false;
+        snapshot.assign(records);
+        liveSeen = seq;
+        version++;
+        return true;
+    }
+    
+    //O(1) lookup by drink id, -1 if not found
+    int findSlot(int id) const {
+        return snapshot.findSlot(id);
+    }
+    
+    const DrinkRecord* findById(int id) const {
+        int slot = findSlot(id);
+        return slot == -1 ? nullptr : &snapshot.at(slot);
+    }
+    
+    int size() const { return snapshot.count(); }
+    const DrinkRecord& at(int slot) const { return snapshot.at(slot); }
+    const DrinkRecord* data() const { return snapshot.isOpen() ? snapshot.records() : nullptr; }
+    unsigned long getVersion() const { return version; }
+    
+    int categoryCount() const { return snapshot.categoryCount(); }
+    const char* categoryName(int cat) const { return snapshot.category(cat).name; }
+    int categorySize(int cat) const { return (int)snapshot.category(cat).count; }
+    const uint32_t* slotsInCategory(int cat) const { return snapshot.categorySlots(cat); }
+};
+
 //global variables 
 const int MAX_QUANTITY = 20;
-const int MAX_DRINKS = 50;
-const int MAX_CUSTOMERS = 100;
-Drink drinkMenu[MAX_DRINKS];
-int drinkCount = 0;
-Customer customers[MAX_CUSTOMERS];
-int customerCount = 0;
+DrinkCatalog drinkMenu;
+SortView<DrinkRecord> menuView;  //display order of catalog slots
+SearchIndex drinkSearch;         //drink name and category, keyed by drink id
+unsigned long drinkSearchVersion = 0;
+
+//screens are built in one buffer and written at once, see frame_renderer.h
+enum ScreenId { SCREEN_DASHBOARD = 1, SCREEN_MENU, SCREEN_ORDER, SCREEN_RESULTS, SCREEN_CART, SCREEN_EDIT_CART };
+FrameRenderer frame;
+RowCache menuRows;
+Pager menuPager;
+CustomerStore<Customer> customers;  //customers.txt indexed by email and id, the guest first
+CustomerIdGenerator customerIds;    //customer_seq.dat, shared with the other kiosks
+TableJournal customerTable;         //customers.txt plus its journal of edits
+uint64_t customersSize = 0;         //customers.txt fingerprint at the last load, see customersChanged()
+int64_t customersMtime = 0;
+ProfileStore profiles;              //profiles.dat, replaces the <email>.txt per customer
 Customer* currentCustomer = nullptr;
+CartJournal cartJournal;         //carts.<kiosk>.journal on top of carts.<kiosk>.checkpoint
+int guestSession = 0;            //guest carts are journaled under owner -guestSession
+//globals are destroyed in reverse order: historyWriter outlives the order
+//queue, whose workers append to it until the queue has joined them
+HistoryWriter historyWriter;     //order_history.log, written on its own thread
+OrderLog historyReader;          //the same log read on the UI thread, for order history pages
 OrderQueue orderQueue;
-int orderCounter = 1000;
+OrderIdAllocator orderIds;       //kiosk id + sequence from order_seq.dat
+vector<string> orderStatus;      //latest checkout results, shown on the dashboard
+const int HISTORY_PAGE = 5;
+KitchenFloor kitchen(kitchenStaffFromEnv());  //paid orders being made, see kitchen_scheduler.h
+Inventory inventory;             //stock shared with the other kiosks, inventory.bin
+int kioskId = 1;                 //MIXUE_KIOSK_ID, else the first id no running kiosk has
+ServiceClient orderService;      //MIXUE_SERVICE: carts and checkout of logged in customers live there
+atomic<bool> serviceStop(false); //set by SIGINT/SIGTERM in --serve mode
+
+//stock reserved for a cart; a cart left alone for cartHoldSeconds gives its
+//stock back and reserves it again on the next change or at checkout
+struct CartHold {
+    time_t touched;
+    bool held;
+};
+map<int, CartHold> cartHolds;    //by cart journal owner
+int cartHoldSeconds = 15 * 60;
 
 //function prototypes
 void loadDrinksFromFile();
 void loadCustomers();
-void saveCustomers();
-void saveOrderToHistory(Customer* customer, float total, int orderId);
+bool customersChanged();
+void appendCustomer(const Customer& c);
+void loadProfiles();
+void refreshMenu();
+void shutdownKiosk();
+int serveOrders(const char* socketPath);
+int loadTestMode(int argc, char* argv[]);
+bool usingService();
+bool syncServiceCart(Customer* c);
+Customer* serviceLogin(const char* email, const char* password);
+int serviceCartChange(int op, int arg, int quantity, int custom);
+bool serviceCheckout(OrderId& orderId, Cents& total, string& refused);
+int exportProfilesMode(int argc, char* argv[]);
+OrderTicket makeOrderTicket(Customer* customer, Cents total, OrderId orderId);
+int placeOrder(Customer* customer, Cents total, OrderId& orderId, string& refused);
+void recordPaidOrder(const OrderTicket& ticket);
+int loadHistoryPage(Customer* customer, int count);
+void processOrderEvents();
+vector<KitchenItem> kitchenItems(const vector<CartLine>& lines);
+int simulateKitchenMode(int argc, char* argv[]);
 void displayDashboard();
 void viewAllProducts();
 void startOrder();
@@ -141,33 +366,90 @@ void processPayment();
 void loginOrRegister();
 void viewOrderHistory();
 void viewProfile();
-void bubbleSortDrinks(int sortBy);
-int binarySearchDrink(int id);
-void addToCart(Drink drink);
+void sortMenu(int sortBy);
+const vector<int>& menuOrder();
+bool addToCart(int drinkId, int qty, int ice, int sweet);
+Cart& activeCart();
+const char* cartLineName(const CartLine& line);
+const char* choiceName(int choice);
+int setLineCustom(int line, int ice, int sweet);
 void removeFromCart(int itemIndex);
 void clearCart();
-float calculateCartTotal();
+Cents calculateCartTotal();
+int cartOwner();
+Cart* cartForOwner(int owner);
+int applyCartRecord(const CartRecord& r);
+int changeCart(int op, int arg, int quantity = 0, int custom = 0, int priceCents = 0);
+int changeCartFor(int owner, int op, int arg, int quantity = 0, int custom = 0, int priceCents = 0);
+int recordCartChange(int owner, int op, int arg, int quantity = 0, int custom = 0, int priceCents = 0);
+bool holdCart(int owner, int* shortDrink = nullptr);
+void releaseCart(int owner);
+void expireCartHolds();
+bool openInventory();
+void cartState(vector<CartRecord>& records);
+void restoreCarts();
+void startGuestSession();
 void displayDrink(Drink d);
+void addMenuHeader();
+void addMenuRow(int slot);
+void ensureDrinkSearch();
 void pressAnyKey();
 void initializeSystem(); 
-int generateUniqueOrderId();
+OrderId generateUniqueOrderId();
 
 void initializeSystem() {
-    customers[0].id = 0;
-    strcpy(customers[0].name, "Guest");
-    strcpy(customers[0].email, "guest@system");
-    strcpy(customers[0].password, "");
-    customers[0].cart = nullptr;
-    customers[0].orderHistory = nullptr;
-    customers[0].isGuest = true;
-    customerCount = 1; 
+    if (customers.size() == 0) {
+        Customer guest;
+        guest.id = 0;
+        strcpy(guest.name, "Guest");
+        strcpy(guest.email, "guest@system");
+        strcpy(guest.password, "");
+        guest.isGuest = true;
+        customers.add(guest);
+    }
+    sortMenu(0);
 }
 
 //main function
-int main() {
+int main(int argc, char* argv[]) {
+    //--script, --replay and --record drive the kiosk from a file, see platform.h
+    if (!consoleArgs(argc, argv, shutdownKiosk)) {
+        return 1;
+    }
 	initializeSystem();
     loadDrinksFromFile();
+    if (argc > 1 && strcmp(argv[1], "--simulate-kitchen") == 0) {
+        return simulateKitchenMode(argc, argv);
+    }
     loadCustomers();
+    loadProfiles();
+    if (argc > 1 && strcmp(argv[1], "--export-profiles") == 0) {
+        return exportProfilesMode(argc, argv);
+    }
+    //--load-test [kiosks] [seconds] [socket]: drives a running --serve process
+    if (argc > 1 && strcmp(argv[1], "--load-test") == 0) {
+        return loadTestMode(argc, argv);
+    }
+    customerIds.open("customer_seq.dat");
+    if (!openInventory()) {
+        return 1;
+    }
+    restoreCarts();
+    orderIds.open("order_seq.dat", kioskId);
+    //order_history.txt from older versions is imported into the log the first time
+    if (!historyWriter.open("order_history", historySyncFromEnv())) {
+        cerr << "Error: Unable to open order_history.log for writing!\n";
+    }
+    //--serve [socket]: this process owns the data and the other kiosks connect to it
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        int status = serveOrders(argc > 2 ? argv[2] : "mixue.sock");
+        shutdownKiosk();
+        return status;
+    }
+    const char* service = getenv("MIXUE_SERVICE");
+    if (service && !orderService.connect(service)) {
+        cerr << "Warning: order service " << service << " is not running, this kiosk works on its own\n";
+    }
     
       if(!currentCustomer) {
         currentCustomer = &customers[0];
@@ -175,7 +457,9 @@ int main() {
     
     int choice;
     do {
-        system("cls");
+        processOrderEvents();
+        refreshMenu();
+        profiles.flush();   //profile changes from the last screen, in one write
         displayDashboard();
         
         cout<<"\nEnter your choice: ";
@@ -198,160 +482,177 @@ int main() {
         }
     } while(choice != 0);
     
-    saveCustomers();
+    shutdownKiosk();
     return 0;
 }
 
+//orders still at the gateway are finished before the carts are saved
+void shutdownKiosk() {
+    orderQueue.shutdown();
+    if (!historyWriter.close()) {
+        cerr << "Error: " << historyWriter.queueDepth() << " order(s) could not be saved to order_history.log ("
+             << historyWriter.lastError() << ")\n";
+    }
+    processOrderEvents();
+    profiles.close();
+    cartJournal.checkpoint(cartState);
+    inventory.close();   //the saved carts reserve their stock again next time
+}
+
 //core function implementations
 void loadDrinksFromFile() {
-    ifstream file("mixue.txt");
-    if (!file) {
+    //maps mixue.bin, rebuilding it first if mixue.txt has changed
+    if (!drinkMenu.load("mixue.txt", "mixue.bin", "mixue.live")) {
         cerr << "Error opening drink menu file!\n";
         return;
     }
-    
-   string line;
-    while (drinkCount < MAX_DRINKS && getline(file, line)) {
-        size_t pos1 = line.find(',');
-        size_t pos2 = line.find(',', pos1+1);
-        size_t pos3 = line.find(',', pos2+1);
-        size_t pos4 = line.find(',', pos3+1);
-        
-        if (pos1 != string::npos && pos2 != string::npos && 
-            pos3 != string::npos && pos4 != string::npos) {
-            //ID
-            drinkMenu[drinkCount].id = stoi(line.substr(0, pos1));
-            
-            //name
-            string name = line.substr(pos1+1, pos2-pos1-1);
-            strncpy(drinkMenu[drinkCount].name, name.c_str(), 49);
-            drinkMenu[drinkCount].name[49] = '\0';
-            
-            //category
-            string category = line.substr(pos2+1, pos3-pos2-1);
-            strncpy(drinkMenu[drinkCount].category, category.c_str(), 19);
-            drinkMenu[drinkCount].category[19] = '\0';
-            
-            //price
-            drinkMenu[drinkCount].price = stof(line.substr(pos3+1, pos4-pos3-1));
-            
-            //calories
-            drinkMenu[drinkCount].calories = stoi(line.substr(pos4+1));
-            
-            //set default values
-            strcpy(drinkMenu[drinkCount].iceLevel, "Regular");
-            strcpy(drinkMenu[drinkCount].sweetness, "Regular");
-            drinkMenu[drinkCount].quantity = 1;
-            
-            drinkCount++;
-        }
-    }
-    file.close();
-    cout << "Loaded " << drinkCount << " drinks from file\n";
+    cout << "Loaded " << drinkMenu.size() << " drinks from file\n";
+}
+
+//picks up menu and price changes the admin program published since the last screen
+void refreshMenu() {
+    if (!drinkMenu.refresh()) return;
+    inventory.sync(drinkMenu.data(), drinkMenu.size());   //restocks and new drinks
 }
 
 void loadCustomers() {
 	initializeSystem();
 	
-    ifstream file("customers.txt");
-    if (!file) {
+    customerTable.open("customers.txt");
+    tableFingerprint("customers.txt", customersSize, customersMtime);
+    TableRows table;
+    if (!customerTable.read(table)) {
         cout << "No existing customer data.\n";
         return;
     }
     
-string line;
-while (customerCount < MAX_CUSTOMERS && getline(file, line)) {
-        size_t pos1 = line.find(',');
-        size_t pos2 = line.find(',', pos1+1);
-        size_t pos3 = line.find(',', pos2+1);
-        
-        if (pos1 != string::npos && pos2 != string::npos && pos3 != string::npos) {
-            //ID
-            customers[customerCount].id = stoi(line.substr(0, pos1));
-            
-            //name
-            string name = line.substr(pos1+1, pos2-pos1-1);
-            if (!name.empty() && name[0] == ' ') {
-                name = name.substr(1);
-            }
-            strncpy(customers[customerCount].name, name.c_str(), 49);
-            customers[customerCount].name[49] = '\0';
-            
-            //email
-            string email = line.substr(pos2+1, pos3-pos2-1);
-            if (!email.empty() && email[0] == ' ') {
-                email = email.substr(1);
-            }
-            strncpy(customers[customerCount].email, email.c_str(), 99);
-            customers[customerCount].email[99] = '\0';
-            
-            //password
-            string password = line.substr(pos3+1);
-            if (!password.empty() && password[0] == ' ') {
-                password = password.substr(1);
-            }
-            strncpy(customers[customerCount].password, password.c_str(), 49);
-            customers[customerCount].password[49] = '\0';
-            
-            customers[customerCount].cart = nullptr;
-            customers[customerCount].orderHistory = nullptr;
-            customers[customerCount].isGuest = false;
-            customerCount++;
+    //id,name,email,password; the password is the rest of the row, commas and all
+    CsvRowParser parser(table.rows);
+    vector<string_view> fields;
+    while (parser.next(fields)) {
+        Customer c;
+        if (fields.size() < 4) {
+            parser.reject("expected 4 columns");
+            continue;
         }
+        if (!csvToInt(fields[0], c.id)) {
+            parser.reject("bad customer id");
+            continue;
+        }
+        const string_view& last = fields.back();
+        string_view password(fields[3].data(), last.data() + last.size() - fields[3].data());
+
+        //a space after the comma is not part of the value
+        if (!fields[1].empty() && fields[1][0] == ' ') fields[1].remove_prefix(1);
+        if (!fields[2].empty() && fields[2][0] == ' ') fields[2].remove_prefix(1);
+        if (!password.empty() && password[0] == ' ') password.remove_prefix(1);
+        csvCopy(c.name, sizeof(c.name), fields[1]);
+        csvCopy(c.email, sizeof(c.email), fields[2]);
+        csvCopy(c.password, sizeof(c.password), password);
+
+        c.isGuest = false;
+        customers.add(c);   //a repeated email or id keeps the first row
     }
-    file.close();
+    csvReport(stderr, "customers.txt", parser.errors);
+}
+
+//true if customers.txt or its journal changed since loadCustomers() read them
+bool customersChanged() {
+    uint64_t size;
+    int64_t mtime;
+    return tableFingerprint("customers.txt", size, mtime) && (size != customersSize || mtime != customersMtime);
 }
 
-void saveCustomers() {
-    ofstream file("customers.txt");
-    if (!file) {
+//registration and profile edits add one journal record instead of rewriting the whole file
+void appendCustomer(const Customer& c) {
+    ostringstream line;
+    line << c.id << "," << c.name << "," << c.email << "," << c.password;
+    if (!customerTable.put(line.str())) {
         cout << "Error saving customer data!\n";
-        return;
     }
+}
 
-    for (int i = 1; i < customerCount; i++) {
-        file << customers[i].id << ","
-             << customers[i].name << ","
-             << customers[i].email << ","
-             << customers[i].password << "\n";
+//profiles.dat, importing the <email>.txt files of older versions the first time
+void loadProfiles() {
+    if (!profiles.open("profiles")) {
+        cerr << "Error: Unable to open profiles.dat!\n";
+        return;
+    }
+    //the id in customers.txt wins over a stale one in the old file
+    int imported = migrateProfileFiles(profiles, ".", [](Profile& p) {
+        Customer* c = customers.findEmail(p.email.c_str());
+        if (c) p.customerId = c->id;
+    });
+    if (imported > 0) {
+        cout << "Imported " << imported << " customer profiles into profiles.dat\n";
     }
-    file.close();
-    cout << "Customer data saved in CSV format\n";
+}
+
+//--export-profiles [dir]: every profile as <email>.txt, the form older versions wrote
+int exportProfilesMode(int argc, char* argv[]) {
+    string dir = argc > 2 ? argv[2] : ".";
+    int written = exportProfileFiles(profiles, dir);
+    cout << "Exported " << written << " customer profiles to " << dir << "\n";
+    return 0;
 }
 
 void displayDashboard() {
-    system("cls");
+    frame.begin(SCREEN_DASHBOARD);
 
-    cout<<"|----------------------------------------------------------------------------|\n";
-    cout<<"|                            MIXUE ICE CREAM & TEA                           |\n";
-    cout<<"|                      Ice Cream & Tea Ordering System                       |\n";
-    cout<<"|----------------------------------------------------------------------------|\n";
+    frame.add("|----------------------------------------------------------------------------|\n");
+    frame.add("|                            MIXUE ICE CREAM & TEA                           |\n");
+    frame.add("|                      Ice Cream & Tea Ordering System                       |\n");
+    frame.add("|----------------------------------------------------------------------------|\n");
 
     if (currentCustomer) {
-        cout<<"\n                            Welcome, " << currentCustomer->name << "!\n\n";
+        frame.addf("\n                            Welcome, %s!\n\n", currentCustomer->name);
     } else {
-        cout<<"\n                            Welcome, Guest!\n\n";
+        frame.add("\n                            Welcome, Guest!\n\n");
     };
 
-    cout<<"|----------------------------- DASHBOARD ------------------------------------|\n";
-    cout<<"|  [1] View All Products           | Browse our full range of drinks         |\n";
-    cout<<"|  [2] Start New Order             | Begin selecting your favorite drinks    |\n";
-    cout<<"|  [3] View Cart                   | See what you've added to your cart      |\n";
-    cout<<"|  [4] Edit Cart                   | Change quantities or remove items       |\n";
-    cout<<"|  [5] Payment                     | Proceed to checkout and pay             |\n";
-    cout<<"|  [6] Login / Register            | Sign in or create a new account         |\n";
+    frame.add("|----------------------------- DASHBOARD ------------------------------------|\n");
+    frame.add("|  [1] View All Products           | Browse our full range of drinks         |\n");
+    frame.add("|  [2] Start New Order             | Begin selecting your favorite drinks    |\n");
+    frame.add("|  [3] View Cart                   | See what you've added to your cart      |\n");
+    frame.add("|  [4] Edit Cart                   | Change quantities or remove items       |\n");
+    frame.add("|  [5] Payment                     | Proceed to checkout and pay             |\n");
+    frame.add("|  [6] Login / Register            | Sign in or create a new account         |\n");
 
     if (currentCustomer && !currentCustomer->isGuest) {
-        cout<<"|  [7] View Order History          | Review your previous purchases          |\n";
-        cout<<"|  [8] View Profile                | Manage your account information         |\n";
+        frame.add("|  [7] View Order History          | Review your previous purchases          |\n");
+        frame.add("|  [8] View Profile                | Manage your account information         |\n");
     }
 
-    cout<<"|  [0] Exit                        | Close the application                   |\n";
-    cout<<"|----------------------------------------------------------------------------|\n";
+    frame.add("|  [0] Exit                        | Close the application                   |\n");
+    frame.add("|----------------------------------------------------------------------------|\n");
 
 
-    printf("  Total Drinks: %-3d   |  Registered Users: %-3d  ",
-           drinkCount, customerCount - 1);
+    if (orderQueue.size() > 0) {
+        frame.addf("  Orders processing: %d\n", orderQueue.size());
+    }
+    string historyError = historyWriter.lastError();
+    if (!historyError.empty()) {
+        frame.addf("  Order history cannot be saved, retrying: %s\n", historyError.c_str());
+    }
+    if (historyWriter.queueDepth() > 0) {
+        frame.addf("  Orders waiting to be saved: %d\n", (int)historyWriter.queueDepth());
+    }
+    if (kitchen.openOrders() > 0) {
+        frame.addf("  Kitchen: %d order(s) in progress, %d drink(s) waiting\n",
+                   kitchen.openOrders(), kitchen.waitingCups());
+        for (int s = 0; s < kitchen.staff(); s++) {
+            const KitchenBatch* b = kitchen.preparing(s);
+            const DrinkRecord* d = b ? drinkMenu.findById(b->drinkId) : nullptr;
+            if (b) frame.addf("    Station %d: %dx %s\n", s + 1, b->quantity, d ? d->name : "?");
+        }
+    }
+    for (size_t i = 0; i < orderStatus.size(); i++) {
+        frame.addf("  %s\n", orderStatus[i].c_str());
+    }
+
+    frame.addf("  Total Drinks: %-3d   |  Registered Users: %-3d  ",
+           drinkMenu.size(), customers.size() - 1);
+    frame.flush();
 }
 
 
@@ -359,68 +660,77 @@ void displayDashboard() {
 void viewAllProducts() {
     int choice;
     do {
-        system("cls");
-        cout<<"================ MIXUE PRODUCT MENU ================\n";
-        cout<<"ID  | Name                    | Category   | Price  | Calories\n";
-        cout<<"----+-------------------------+------------+--------+----------\n";
-
-        for (int i = 0; i < drinkCount; i++) {
-            printf("%-4d| %-24s| %-11s| RM%-5.2f| %-9d\n", 
-                   i + 1, 
-                   drinkMenu[i].name, 
-                   drinkMenu[i].category, 
-                   drinkMenu[i].price, 
-                   drinkMenu[i].calories);
-        }
+        refreshMenu();
+        const vector<int>& order = menuOrder();
+        int total = (int)order.size();
+
+        frame.begin(SCREEN_MENU);
+        frame.add("================ MIXUE PRODUCT MENU ================\n");
+        addMenuHeader();
 
-        cout<<"\n================== OPTIONS ==================\n";
-        cout<<"1. Sort by Price\n";
-        cout<<"2. Sort by Calories\n";
-        cout<<"3. Filter by Category\n";
-        cout<<"4. Search by Name\n";
-        cout<<"0. Back to Dashboard\n";
-        cout<<"=============================================\n";
-        cout<<"Enter your choice: ";
+        //only the visible page is formatted and written
+        for (int i = menuPager.first(total); i < menuPager.last(total); i++) {
+            addMenuRow(order[i]);
+        }
+        frame.addf("Page %d of %d\n", menuPager.page + 1, menuPager.pageCount(total));
+
+        frame.add("\n================== OPTIONS ==================\n");
+        frame.add("1. Sort by Price\n");
+        frame.add("2. Sort by Calories\n");
+        frame.add("3. Filter by Category\n");
+        frame.add("4. Search by Name\n");
+        frame.add("5. Sort by Category, then Price\n");
+        frame.add("6. Sort by Name\n");
+        frame.add("7. Sort by ID\n");
+        frame.add("8. Next Page\n");
+        frame.add("9. Previous Page\n");
+        frame.add("0. Back to Dashboard\n");
+        frame.add("=============================================\n");
+        frame.add("Enter your choice: ");
+        frame.flush();
         cin>>choice;
         cout<<"\n";
 
         switch (choice) {
             case 1:
-                bubbleSortDrinks(1);
+            case 2:
+            case 5:
+            case 6:
+            case 7:
+                sortMenu(choice);
+                menuPager.page = 0;
+                cout<<"Sort completed!\n";
+                pressAnyKey();
                 break;
 
-            case 2:
-                bubbleSortDrinks(2);
+            case 8:
+                menuPager.next(total);
                 break;
 
-            case 3: {
-                char categories[3][20] = {"Beverage", "Juice", "Tea"};
+            case 9:
+                menuPager.prev();
+                break;
 
+            case 3: {
                 cout<<"Available categories:\n";
-                for (int i = 0; i < 3; i++) {
-                    cout<<i + 1 << ". " << categories[i] << "\n";
+                for (int i = 0; i < drinkMenu.categoryCount(); i++) {
+                    cout<<i + 1 << ". " << drinkMenu.categoryName(i) << "\n";
                 }
 
                 int catChoice;
-                cout<<"Select category (1-3): ";
+                cout<<"Select category (1-" << drinkMenu.categoryCount() << "): ";
                 cin>>catChoice;
 
-                if (catChoice >= 1 && catChoice <= 3) {
-                    system("cls");
-                    cout<<"========== FILTER: " << categories[catChoice - 1] << " ==========\n";
-                    cout<<"ID  | Name                    | Category   | Price  | Calories\n";
-                    cout<<"----+-------------------------+------------+--------+----------\n";
-
-                    for (int i = 0; i < drinkCount; i++) {
-                        if (strcmp(drinkMenu[i].category, categories[catChoice - 1]) == 0) {
-                            printf("%-4d| %-24s| %-11s| RM%-5.2f| %-9d\n",
-                                   i + 1,
-                                   drinkMenu[i].name,
-                                   drinkMenu[i].category,
-                                   drinkMenu[i].price,
-                                   drinkMenu[i].calories);
-                        }
+                if (catChoice >= 1 && catChoice <= drinkMenu.categoryCount()) {
+                    frame.begin(SCREEN_RESULTS);
+                    frame.addf("========== FILTER: %s ==========\n", drinkMenu.categoryName(catChoice - 1));
+                    addMenuHeader();
+
+                    const uint32_t* slots = drinkMenu.slotsInCategory(catChoice - 1);
+                    for (int i = 0; i < drinkMenu.categorySize(catChoice - 1); i++) {
+                        addMenuRow(slots[i]);
                     }
+                    frame.flush();
                 } else {
                     cout<<"Invalid category choice!\n";
                 }
@@ -430,44 +740,31 @@ void viewAllProducts() {
             }
 
             case 4: {
-                system("cls");
+                frame.clear();
                 cout<<"===== SEARCH BY NAME =====\n";
                 cout<<"Enter product name to search: ";
                 cin.ignore();
                 char searchName[50];
                 cin.getline(searchName, 50);
 
-                bool found = false;
-
-                cout<<"\nSearch Results:\n";
-                cout<<"ID  | Name                    | Category   | Price  | Calories\n";
-                cout<<"----+-------------------------+------------+--------+----------\n";
+                //ranked: exact and substring matches first, then close spellings
+                ensureDrinkSearch();
+                vector<SearchHit> hits = drinkSearch.search(searchName);
 
-                for (int i = 0; i < drinkCount; i++) {
-                    char nameLower[50], searchLower[50];
-                    strcpy(nameLower, drinkMenu[i].name);
-                    strcpy(searchLower, searchName);
+                frame.begin(SCREEN_RESULTS);
+                frame.add("===== SEARCH BY NAME =====\n");
+                frame.addf("Search Results for \"%s\":\n", searchName);
+                addMenuHeader();
 
-                    for (int j = 0; nameLower[j]; j++) 
-                        nameLower[j] = tolower(nameLower[j]);
-
-                    for (int j = 0; searchLower[j]; j++) 
-                        searchLower[j] = tolower(searchLower[j]);
-
-                    if (strstr(nameLower, searchLower)) {
-                        printf("%-4d| %-24s| %-11s| RM%-5.2f| %-9d\n",
-                               i + 1,
-                               drinkMenu[i].name,
-                               drinkMenu[i].category,
-                               drinkMenu[i].price,
-                               drinkMenu[i].calories);
-                        found = true;
-                    }
+                for (int i = 0; i < (int)hits.size(); i++) {
+                    int slot = drinkMenu.findSlot(hits[i].key);
+                    if (slot != -1) addMenuRow(slot);
                 }
 
-                if (!found) {
-                    cout<<"No matching products found.\n";
+                if (hits.empty()) {
+                    frame.add("No matching products found.\n");
                 }
+                frame.flush();
 
                 pressAnyKey();
                 break;
@@ -486,40 +783,50 @@ void viewAllProducts() {
 
 void startOrder() {
     int drinkChoice;
-    char cont;
+    char cont = 'y';
 
     do {
-        system("cls");
-        cout<<"========== MIXUE DRINK MENU ==========\n";
-        cout<<"ID  | Name                    | Category   | Price  | Calories\n";
-        cout<<"----+-------------------------+------------+--------+----------\n";
-
-        for (int i = 0; i < drinkCount; i++) {
-            printf("%-4d| %-24s| %-11s| RM%-5.2f| %-9d\n",
-                   i + 1,
-                   drinkMenu[i].name,
-                   drinkMenu[i].category,
-                   drinkMenu[i].price,
-                   drinkMenu[i].calories);
+        refreshMenu();
+        //redraws of the same page only rewrite the prompt line
+        const vector<int>& order = menuOrder();
+        int total = (int)order.size();
+
+        frame.begin(SCREEN_ORDER);
+        frame.add("========== MIXUE DRINK MENU ==========\n");
+        addMenuHeader();
+
+        for (int i = menuPager.first(total); i < menuPager.last(total); i++) {
+            addMenuRow(order[i]);
         }
+        frame.addf("Page %d of %d\n", menuPager.page + 1, menuPager.pageCount(total));
+
+        frame.add("\nEnter Drink ID to order (N/P for next/previous page): ");
+        frame.flush();
 
-        cout<<"\nEnter Drink ID to order (1-" << drinkCount << "): ";
-        cin>>drinkChoice;
+        string input;
+        cin>>input;
+        if (input == "n" || input == "N") {
+            menuPager.next(total);
+            continue;
+        }
+        if (input == "p" || input == "P") {
+            menuPager.prev();
+            continue;
+        }
+        drinkChoice = atoi(input.c_str());
 
-        if (drinkChoice < 1 || drinkChoice > drinkCount) {
+        const DrinkRecord* found = drinkMenu.findById(drinkChoice);
+        if (!found) {
             cout<<"Invalid ID!\n";
             pressAnyKey();
             return;
         }
 
-        Drink selected = drinkMenu[drinkChoice - 1];
-
         //Set quantity
         int qty;
         cout<<"\nEnter quantity (1-" << MAX_QUANTITY << "): ";
         cin>>qty;
         if (qty < 1 || qty > MAX_QUANTITY) qty = 1;
-        selected.quantity = qty;
 
         //Set ice level
         cout<<"\nChoose Ice Level:\n";
@@ -527,12 +834,7 @@ void startOrder() {
         int ice;
         cout<<"Enter choice: ";
         cin>>ice;
-        switch (ice) {
-            case 2: strcpy(selected.iceLevel, "Less"); break;
-            case 3: strcpy(selected.iceLevel, "None"); break;
-            default: strcpy(selected.iceLevel, "Regular");
-        }
-        selected.iceChoice = ice;
+        if (ice < 1 || ice > 3) ice = 1;
 
         //Set sweetness
         cout<<"\nChoose Sweetness:\n";
@@ -540,16 +842,17 @@ void startOrder() {
         int sweet;
         cout<<"Enter choice: ";
         cin>>sweet;
-        switch (sweet) {
-            case 2: strcpy(selected.sweetness, "Less"); break;
-            case 3: strcpy(selected.sweetness, "None"); break;
-            default: strcpy(selected.sweetness, "Regular");
+        if (sweet < 1 || sweet > 3) sweet = 1;
+
+        //Add to cart, same drink and customization go on one line
+        if (addToCart(found->id, qty, ice, sweet)) {
+            cout<<"Item added to cart!\n";
+        } else if (inventory.isOpen() && inventory.available(found->id) != -1 &&
+                   inventory.available(found->id) < qty) {
+            cout<<"Sorry, only " << inventory.available(found->id) << " left!\n";
+        } else {
+            cout<<"Max " << MAX_QUANTITY << " of the same drink per line!\n";
         }
-        selected.sweetChoice = sweet;
-
-        //Add to cart
-        addToCart(selected);
-        cout<<"Item added to cart!\n";
 
         cout<<"\nOrder another item? (y/n): ";
         cin>>cont;
@@ -561,93 +864,323 @@ void startOrder() {
 }
 
 
-void addToCart(Drink drink) {
-    CartItem* newItem = new CartItem;
-    newItem->drink = drink;
-    newItem->next = nullptr;
+bool addToCart(int drinkId, int qty, int ice, int sweet) {
+    const DrinkRecord* d = drinkMenu.findById(drinkId);
+    if (!d) return false;
+    return changeCart(CART_ADD, drinkId, qty, ice | (sweet << 4), d->priceCents) != -1;
+}
+
+//cart of the logged in customer, or the guest cart
+Cart& activeCart() {
+    return currentCustomer ? currentCustomer->cart : customers[0].cart;
+}
+
+//journal owner of the active cart: the customer id, or the guest session
+int cartOwner() {
+    if (currentCustomer && !currentCustomer->isGuest) return currentCustomer->id;
+    return -guestSession;
+}
+
+Cart* cartForOwner(int owner) {
+    if (owner <= 0) return &customers[0].cart;
+    Customer* c = customers.findId(owner);
+    return c ? &c->cart : nullptr;  //null if no longer registered
+}
+
+//applies one journal record; returns the line index for add and customization
+//changes, 0 for the others, -1 if nothing changed
+int applyCartRecord(const CartRecord& r) {
+    if (r.op == CART_GUEST_SESSION) {
+        guestSession = -r.owner;
+        customers[0].cart.clear();
+        return 0;
+    }
+
+    Cart* cart = cartForOwner(r.owner);
+    if (!cart) return -1;
+    bool lineOk = r.arg >= 0 && r.arg < cart->size();
+    switch (r.op) {
+        case CART_ADD:
+            return cart->add(r.arg, r.priceCents, r.quantity, r.custom & 0x0F, r.custom >> 4, MAX_QUANTITY);
+        case CART_SET_QTY:
+            if (!lineOk) return -1;
+            cart->setQuantity(r.arg, r.quantity);
+            return 0;
+        case CART_SET_CUSTOM:
+            if (!lineOk) return -1;
+            return cart->setCustom(r.arg, r.custom & 0x0F, r.custom >> 4, MAX_QUANTITY);
+        case CART_REMOVE:
+            if (!lineOk) return -1;
+            cart->remove(r.arg);
+            return 0;
+        case CART_CLEAR:
+            cart->clear();
+            return 0;
+    }
+    return -1;
+}
+
+//every cart change goes through here, so replaying the journal repeats exactly
+//what happened; the record is written before control returns to the customer
+int changeCart(int op, int arg, int quantity, int custom, int priceCents) {
+    if (usingService()) return serviceCartChange(op, arg, quantity, custom);
+    return changeCartFor(cartOwner(), op, arg, quantity, custom, priceCents);
+}
+
+//stock moves with the cart: adding reserves it, removing gives it back.
+//-1 if the change is invalid or there is not enough stock
+int changeCartFor(int owner, int op, int arg, int quantity, int custom, int priceCents) {
+    Cart* cart = cartForOwner(owner);
+    if (!cart || !inventory.isOpen() || !holdCart(owner)) {
+        return recordCartChange(owner, op, arg, quantity, custom, priceCents);
+    }
     
-    if (!currentCustomer) {
-        //For guests, create a temporary cart
-        if (!customers[0].cart) {
-            customers[0].cart = newItem;
-        } else {
-            CartItem* current = customers[0].cart;
-            while (current->next) {
-                current = current->next;
-            }
-            current->next = newItem;
+    //arg is a drink id for CART_ADD and a line index for the line ops
+    bool lineOp = op == CART_SET_QTY || op == CART_SET_CUSTOM || op == CART_REMOVE;
+    bool lineOk = lineOp && arg >= 0 && arg < cart->size();
+    int drinkId = op == CART_ADD ? arg : (lineOk ? cart->at(arg).drinkId : 0);
+    int delta = 0;
+    if (op == CART_ADD) delta = quantity;
+    else if (op == CART_SET_QTY && lineOk) delta = quantity - cart->at(arg).quantity;
+    if (delta > 0 && !inventory.reserve(drinkId, delta)) return -1;
+    
+    vector<CartLine> before;
+    if (op == CART_CLEAR) {
+        for (int i = 0; i < cart->size(); i++) before.push_back(cart->at(i));
+    } else if (op == CART_REMOVE && lineOk) {
+        before.push_back(cart->at(arg));
+    }
+    
+    int result = recordCartChange(owner, op, arg, quantity, custom, priceCents);
+    if (result == -1) {
+        if (delta > 0) inventory.release(drinkId, delta);
+        return -1;
+    }
+    if (delta < 0) inventory.release(drinkId, -delta);
+    for (size_t i = 0; i < before.size(); i++) inventory.release(before[i].drinkId, before[i].quantity);
+    return result;
+}
+
+//applies and journals a change without touching stock
+int recordCartChange(int owner, int op, int arg, int quantity, int custom, int priceCents) {
+    CartRecord r;
+    memset(&r, 0, sizeof(r));
+    r.op = (uint8_t)op;
+    r.owner = owner;
+    r.arg = arg;
+    r.quantity = (uint16_t)quantity;
+    r.custom = (uint8_t)custom;
+    r.priceCents = priceCents;
+
+    int result = applyCartRecord(r);
+    if (result == -1) return -1;
+    cartJournal.append(r);
+    cartJournal.commit();
+    if (cartJournal.checkpointDue()) cartJournal.checkpoint(cartState);
+    return result;
+}
+
+//every cart as the records that rebuild it, for a checkpoint
+void cartState(vector<CartRecord>& records) {
+    CartRecord r;
+    memset(&r, 0, sizeof(r));
+    r.op = CART_GUEST_SESSION;
+    r.owner = -guestSession;
+    records.push_back(r);
+
+    for (int i = 0; i < customers.size(); i++) {
+        const Cart& cart = customers[i].cart;
+        for (int j = 0; j < cart.size(); j++) {
+            const CartLine& line = cart.at(j);
+            memset(&r, 0, sizeof(r));
+            r.op = CART_ADD;
+            r.owner = i == 0 ? -guestSession : customers[i].id;
+            r.arg = line.drinkId;
+            r.quantity = line.quantity;
+            r.custom = line.custom;
+            r.priceCents = line.priceCents;
+            records.push_back(r);
         }
-    } else {
-        if (!currentCustomer->cart) {
-            currentCustomer->cart = newItem;
-        } else {
-            CartItem* current = currentCustomer->cart;
-            while (current->next) {
-                current = current->next;
-            }
-            current->next = newItem;
+    }
+}
+
+//rebuilds carts from the last checkpoint and journal, then compacts them
+//each kiosk has its own carts.<kiosk>.journal and .checkpoint; with one shared
+//pair a kiosk's checkpoint would wipe the other kiosks' carts
+void restoreCarts() {
+    string prefix = "carts." + to_string(kioskId);
+    string journal = prefix + ".journal", checkpoint = prefix + ".checkpoint";
+    FILE* own = fopen(checkpoint.c_str(), "rb");
+    if (own) {
+        fclose(own);
+    } else if (kioskId == 1) {
+        //carts saved before the files were per kiosk belong to the default kiosk
+        rename("carts.checkpoint", checkpoint.c_str());
+        rename("carts.journal", journal.c_str());
+    }
+    cartJournal.open(journal.c_str(), checkpoint.c_str(), [](const CartRecord& r) {
+        applyCartRecord(r);
+    });
+
+    int restored = 0;
+    for (int i = 0; i < customers.size(); i++) {
+        if (!customers[i].cart.empty()) restored++;
+    }
+    if (restored > 0) cout << "Restored " << restored << " saved cart(s)\n";
+
+    if (!cartJournal.checkpoint(cartState)) {
+        cerr << "Warning: carts will not be saved, " << checkpoint << " is not writable\n";
+    }
+    //an unfinished guest basket is picked up again, otherwise a new guest starts
+    if (customers[0].cart.empty()) startGuestSession();
+    
+    //restored carts reserve their stock again; one that cannot keeps its items
+    //and is checked again at checkout
+    for (int i = 0; i < customers.size(); i++) {
+        if (!customers[i].cart.empty()) holdCart(i == 0 ? -guestSession : customers[i].id);
+    }
+}
+
+void startGuestSession() {
+    CartRecord r;
+    memset(&r, 0, sizeof(r));
+    r.op = CART_GUEST_SESSION;
+    r.owner = -(guestSession + 1);
+    applyCartRecord(r);
+    cartJournal.append(r);
+    cartJournal.commit();
+}
+
+//maps inventory.bin and brings it up to date with the stock in mixue.txt.
+//registering there also settles this kiosk's id; false if the id asked for
+//with MIXUE_KIOSK_ID belongs to a kiosk that is running
+bool openInventory() {
+    const char* hold = getenv("MIXUE_CART_HOLD_MIN");
+    if (hold && atoi(hold) > 0) cartHoldSeconds = atoi(hold) * 60;
+    kioskId = kioskIdFromEnv();
+    if (!inventory.open("inventory.bin", kioskIdFromEnv(0), drinkMenu.size())) {
+        if (inventory.isBusy()) {
+            cerr << "Kiosk " << kioskId << " is already running, set MIXUE_KIOSK_ID to another number\n";
+            return false;
+        }
+        cerr << "Warning: inventory.bin could not be opened, stock is not being checked\n";
+        return true;
+    }
+    kioskId = inventory.id();
+    inventory.sync(drinkMenu.data(), drinkMenu.size());
+    return true;
+}
+
+//makes sure every line of the cart has its stock reserved; on failure nothing
+//is reserved and shortDrink is the first drink that ran out
+bool holdCart(int owner, int* shortDrink) {
+    Cart* cart = cartForOwner(owner);
+    if (!cart) return false;
+    CartHold& hold = cartHolds[owner];
+    if (hold.touched == 0) hold.held = cart->empty();   //restored carts hold nothing yet
+    hold.touched = time(0);
+    if (hold.held || !inventory.isOpen()) return true;
+    
+    for (int i = 0; i < cart->size(); i++) {
+        const CartLine& line = cart->at(i);
+        if (!inventory.reserve(line.drinkId, line.quantity)) {
+            for (int j = 0; j < i; j++) inventory.release(cart->at(j).drinkId, cart->at(j).quantity);
+            if (shortDrink) *shortDrink = line.drinkId;
+            return false;
+        }
+    }
+    hold.held = true;
+    return true;
+}
+
+//gives back the stock reserved by a cart, its items stay in the cart
+void releaseCart(int owner) {
+    map<int, CartHold>::iterator it = cartHolds.find(owner);
+    if (it == cartHolds.end() || !it->second.held) return;
+    Cart* cart = cartForOwner(owner);
+    for (int i = 0; cart && i < cart->size(); i++) {
+        inventory.release(cart->at(i).drinkId, cart->at(i).quantity);
+    }
+    it->second.held = false;
+}
+
+//releases carts idle for longer than cartHoldSeconds; called before each dashboard
+void expireCartHolds() {
+    if (!inventory.isOpen()) return;
+    if (!inventory.heartbeat()) {
+        //another kiosk gave our stock back while we were idle
+        for (map<int, CartHold>::iterator it = cartHolds.begin(); it != cartHolds.end(); ++it) {
+            it->second.held = false;
         }
     }
+    
+    time_t now = time(0);
+    for (map<int, CartHold>::iterator it = cartHolds.begin(); it != cartHolds.end(); ) {
+        Cart* cart = cartForOwner(it->first);
+        bool current = it->first > 0 || it->first == -guestSession;
+        if (!current || !cart || cart->empty()) {
+            it = cartHolds.erase(it);   //nothing reserved
+            continue;
+        }
+        if (it->second.held && now - it->second.touched > cartHoldSeconds) releaseCart(it->first);
+        ++it;
+    }
+    inventory.flush();
 }
 
 bool viewCart() {
-    system("cls");
-    cout<<"+--------------------------------------------------------------------------+\n";
-    cout<<"|                             YOUR CART                                    |\n";
-    cout<<"+--------------------------------------------------------------------------+\n";
-
-    CartItem* cart = currentCustomer ? currentCustomer->cart : customers[0].cart;
-    if (!cart) {
-        cout<<"|                                                                          |\n";
-        cout<<"| Your cart is currently empty.                                            |\n";
-        cout<<"+--------------------------------------------------------------------------+\n";
+    if (usingService()) syncServiceCart(currentCustomer);
+    frame.begin(SCREEN_CART);
+    frame.add("+--------------------------------------------------------------------------+\n");
+    frame.add("|                             YOUR CART                                    |\n");
+    frame.add("+--------------------------------------------------------------------------+\n");
+
+    const Cart& cart = activeCart();
+    if (cart.empty()) {
+        frame.add("|                                                                          |\n");
+        frame.add("| Your cart is currently empty.                                            |\n");
+        frame.add("+--------------------------------------------------------------------------+\n");
+        frame.flush();
         pressAnyKey();
         displayDashboard();
         return true;
     }
 
-    int index = 1;
-    float total = 0;
-    CartItem* current = cart;
-
-    cout<<"\n";
-    cout<<"+-----+-------------------------------+------+-----------------------------+\n";
-    cout<<"| No  | Drink Name                    | Qty  | Customization               |\n";
-    cout<<"+-----+-------------------------------+------+-----------------------------+\n";
-
-    while (current) {
-        printf("| %-3d | %-29s | %-4d | Ice: %-7s Sweet: %-7s |\n",
-               index,
-               current->drink.name,
-               current->drink.quantity,
-               current->drink.iceLevel,
-               current->drink.sweetness);
-        total += current->drink.price * current->drink.quantity;
-        current = current->next;
-        index++;
+    frame.add("\n");
+    frame.add("+-----+-------------------------------+------+-----------------------------+\n");
+    frame.add("| No  | Drink Name                    | Qty  | Customization               |\n");
+    frame.add("+-----+-------------------------------+------+-----------------------------+\n");
+
+    for (int i = 0; i < cart.size(); i++) {
+        const CartLine& line = cart.at(i);
+        frame.addf("| %-3d | %-29s | %-4d | Ice: %-7s Sweet: %-7s |\n",
+               i + 1,
+               cartLineName(line),
+               line.quantity,
+               choiceName(line.ice()),
+               choiceName(line.sweet()));
     }
 
-    cout<<"+-----+-------------------------------+------+-----------------------------+\n";
+    frame.add("+-----+-------------------------------+------+-----------------------------+\n");
 
-	char formattedTotal[50];
-	snprintf(formattedTotal, sizeof(formattedTotal), "%.2f", total);
-	string totalLine = "Total Amount: RM " + string(formattedTotal); 
+	string totalLine = "Total Amount: RM " + formatCents(cart.subtotalCents()); 
 	
-    printf("| %-71s  |\n", totalLine.c_str());
-    cout<<"+--------------------------------------------------------------------------+\n";
+    frame.addf("| %-71s  |\n", totalLine.c_str());
+    frame.add("+--------------------------------------------------------------------------+\n");
 
 
-    cout<<"\n";
-    cout<<"+----------------------+\n";
-    cout<<"| 1. Proceed to Payment|\n";
-    cout<<"| 2. Edit Cart         |\n";
-    cout<<"| 3. Remove Item       |\n";
-    cout<<"| 4. Clear Cart        |\n";
-    cout<<"| 0. Back              |\n";
-    cout<<"+----------------------+\n";
+    frame.add("\n");
+    frame.add("+----------------------+\n");
+    frame.add("| 1. Proceed to Payment|\n");
+    frame.add("| 2. Edit Cart         |\n");
+    frame.add("| 3. Remove Item       |\n");
+    frame.add("| 4. Clear Cart        |\n");
+    frame.add("| 0. Back              |\n");
+    frame.add("+----------------------+\n");
 
     int choice;
-    cout<<"\nEnter choice: ";
+    frame.add("\nEnter choice: ");
+    frame.flush();
     cin>>choice;
 
     switch(choice) {
@@ -674,73 +1207,57 @@ bool viewCart() {
 
 
 void removeFromCart(int itemIndex) {
-    CartItem** cart = currentCustomer ? &(currentCustomer->cart) : &(customers[0].cart);
-    
-    if (itemIndex == 1) {
-        CartItem* temp = *cart;
-        *cart = (*cart)->next;
-        delete temp;
-    } else {
-        CartItem* current = *cart;
-        for (int i = 1; i < itemIndex - 1 && current; i++) {
-            current = current->next;
-        }
-        
-        if (current && current->next) {
-            CartItem* temp = current->next;
-            current->next = temp->next;
-            delete temp;
-        }
+    if (itemIndex < 1 || itemIndex > activeCart().size()) {
+        cout<<"Invalid item number!\n";
+        pressAnyKey();
+        return;
     }
+    changeCart(CART_REMOVE, itemIndex - 1);
     cout<<"Item removed from cart!\n";
     pressAnyKey();
     viewCart();
 }
 
 void clearCart() {
-    CartItem** cart = currentCustomer ? &(currentCustomer->cart) : &(customers[0].cart);
-    while (*cart) {
-        CartItem* temp = *cart;
-        *cart = (*cart)->next;
-        delete temp;
-    }
+    changeCart(CART_CLEAR, 0);
     cout<<"Cart cleared!\n";
     pressAnyKey();
 }
 
 void processPayment() {
-    system("cls");
+    frame.clear();
     cout << "+--------------------------------------------------+\n";
     cout << "|                    PAYMENT                       |\n";
     cout << "+--------------------------------------------------+\n";
     
     //get appropriate cart (current user or guest)
-    CartItem* cart = currentCustomer ? currentCustomer->cart : customers[0].cart;
-    if (!cart) {
+    if (usingService()) syncServiceCart(currentCustomer);
+    Cart& cart = activeCart();
+    if (cart.empty()) {
         cout << "| Your cart is empty!                              |\n";
         cout << "+--------------------------------------------------+\n";
         pressAnyKey();
         return;
     }
     
-    //display cart contents
-    float total = calculateCartTotal();
+    //price every line in one pass; the receipt and history use the same amounts
+    PriceBatch batch;
+    cart.priceInto(batch);
+    Cents total = batch.run();
     cout << "\n+--------------------------------------------------+\n";
     cout << "|                  CART ITEMS                      |\n";
     cout << "+--------------------------------------------------+\n";
     
-    CartItem* current = cart;
-    int itemNum = 1;
-    while (current) {
-        cout << "| " << itemNum++ << ". " << current->drink.name 
-             << " (" << current->drink.quantity << "x)"
-             << " - RM " << current->drink.price * current->drink.quantity << "\n";
-        current = current->next;
+    for (int i = 0; i < cart.size(); i++) {
+        const CartLine& line = cart.at(i);
+        cout << "| " << i + 1 << ". " << cartLineName(line)
+             << " (" << line.quantity << "x)"
+             << " - RM " << formatCents(batch.lineTotal(i)) << "\n";
     }
     
     cout << "+--------------------------------------------------+\n";
-    cout << "| SUBTOTAL: RM " << total << "\n";
-    cout << "| FINAL TOTAL: RM " << total << "\n";
+    cout << "| SUBTOTAL: RM " << formatCents(total) << "\n";
+    cout << "| FINAL TOTAL: RM " << formatCents(total) << "\n";
     cout << "+--------------------------------------------------+\n\n";
     
     //payment options
@@ -756,44 +1273,40 @@ void processPayment() {
     
     switch (choice) {
         case 1: {
-            //process payment
-            cout << "Processing payment...\n";
-            for (int i = 3; i > 0; i--) {
-                cout << i << "... ";
-                Sleep(1000); // More reliable delay for Windows
-            }
-            
-            //process order ID
-            int orderId = generateUniqueOrderId();
-            if (orderId == -1) {
-                cout << "Payment failed - could not generate order ID\n";
+            //payment runs in the background, the result shows on the dashboard
+            OrderId orderId;
+            string refused;
+            bool placed = usingService() ? serviceCheckout(orderId, total, refused)
+                                         : placeOrder(currentCustomer ? currentCustomer : &customers[0], total, orderId, refused) == SVC_OK;
+            if (!placed) {
+                cout << refused << "\n";
                 pressAnyKey();
                 return;
             }
             
-            orderQueue.enqueue(orderId);
-            int processedId = orderQueue.dequeue();
-            
             //order confirmation
             cout << "\n\n+=================================================+\n";
-            cout << "|               ORDER COMPLETE                    |\n";
+            cout << "|               ORDER SUBMITTED                   |\n";
             cout << "+=================================================+\n";
             cout << "| Order ID: #" << orderId << "\n";
-            cout << "| Total   : RM " << total << "\n";
+            cout << "| Total   : RM " << formatCents(total) << "\n";
             cout << "| Items   :\n";
             
-            current = cart;
-            while (current) {
-                cout << "| - " << current->drink.name 
-                     << " (" << current->drink.quantity << "x)\n";
-                current = current->next;
+            for (int i = 0; i < cart.size(); i++) {
+                cout << "| - " << cartLineName(cart.at(i))
+                     << " (" << cart.at(i).quantity << "x)\n";
             }
+            cout << "| Payment is processing, check the dashboard.\n";
             cout << "+--------------------------------------------------+\n";
             
-            //save order and clean up
-            saveOrderToHistory(currentCustomer ? currentCustomer : &customers[0], total, orderId);
-            clearCart();
+            //the ticket holds the items and their reserved stock now; they come
+            //back if payment is declined. the service has cleared its copy already
+            if (usingService()) cart.clear();
+            else recordCartChange(cartOwner(), CART_CLEAR, 0);
+            cout << "Cart cleared!\n";
             pressAnyKey();
+            //the next guest at this kiosk gets a cart of their own
+            if (!currentCustomer || currentCustomer->isGuest) startGuestSession();
             break;
         }
         
@@ -812,63 +1325,549 @@ void processPayment() {
 }
 
 
-void saveOrderToHistory(Customer* customer, float total, int orderId) {
-    OrderHistory* newOrder = new OrderHistory;
-    newOrder->orderId = orderId;
-    newOrder->orderDate = time(0);
-    newOrder->totalAmount = total;
+//reserves, numbers and queues the customer's cart for payment, leaving the cart
+//as it is; SVC_OK, or SVC_FAILED / SVC_BUSY with the reason in refused
+int placeOrder(Customer* customer, Cents total, OrderId& orderId, string& refused) {
+    //the cart's stock must still be reserved, it may have been given back while idle
+    int owner = customer->isGuest ? -guestSession : customer->id;
+    int shortDrink = 0;
+    if (!holdCart(owner, &shortDrink)) {
+        const DrinkRecord* d = drinkMenu.findById(shortDrink);
+        refused = "Sorry, only " + to_string(inventory.available(shortDrink)) + " " +
+                  (d ? d->name : "of a drink") + " left - please edit your cart.";
+        return SVC_FAILED;
+    }
     
-    //count items and build item details string
-    int itemCount = 0;
-    string itemDetails;
-    CartItem* current = customer->cart;
+    //process order ID
+    orderId = generateUniqueOrderId();
+    if (orderId == -1) {
+        refused = "Payment failed - could not generate order ID";
+        return SVC_FAILED;
+    }
     
-    while (current) {
-        itemCount += current->drink.quantity;
-        
-        char itemStr[200];
-        snprintf(itemStr, sizeof(itemStr), "%s (%d) - %s ice, %s sweet - RM %.2f",
-                current->drink.name,
-                current->drink.quantity,
-                current->drink.iceLevel,
-                current->drink.sweetness,
-                current->drink.price * current->drink.quantity);
-        
-        itemDetails += itemStr;
-        current = current->next;
+    OrderTicket ticket = makeOrderTicket(customer, total, orderId);
+    if (!orderQueue.enqueue(ticket)) {
+        refused = "Checkout is busy, please try again in a moment.";
+        return SVC_BUSY;
+    }
+    return SVC_OK;
+}
+
+//snapshot of the cart for the pipeline, taken on the UI thread
+OrderTicket makeOrderTicket(Customer* customer, Cents total, OrderId orderId) {
+    OrderTicket ticket;
+    ticket.id = orderId;
+    ticket.customerId = customer->isGuest ? 0 : customer->id;
+    ticket.owner = customer->isGuest ? -guestSession : customer->id;
+    ticket.total = total;
+    ticket.placed = time(0);
+    
+    //item count is kept by the cart, build the item details
+    const Cart& cart = customer->cart;
+    ticket.itemCount = cart.itemCount();
+    PriceBatch batch;
+    cart.priceInto(batch);
+    batch.run();
+    
+    for (int i = 0; i < cart.size(); i++) {
+        const CartLine& line = cart.at(i);
+        ticket.lines.push_back(line);
         
-        if (current) {
-            itemDetails += ", ";
+        OrderLogItem item;
+        item.drinkId = line.drinkId;
+        item.quantity = line.quantity;
+        item.ice = line.ice();
+        item.sweet = line.sweet();
+        item.lineCents = batch.lineTotal(i);
+        item.name = cartLineName(line);
+        ticket.items.push_back(item);
+    }
+    return ticket;
+}
+
+//fulfillment stage, runs on the pipeline's worker thread once payment is approved;
+//the record is queued for the history writer, the log is never touched here
+void appendHistoryLine(const OrderTicket& ticket) {
+    OrderLogRecord record;
+    record.orderId = ticket.id;
+    record.customerId = ticket.customerId;
+    record.placed = ticket.placed;
+    record.total = ticket.total;
+    record.itemCount = ticket.itemCount;
+    record.items = ticket.items;
+    record.offset = -1;
+    historyWriter.append(record);
+}
+
+//a paid order is in the log (or about to be); any pages the customer already
+//read are dropped so the next view starts from the newest order
+void recordPaidOrder(const OrderTicket& ticket) {
+    Customer* c = ticket.customerId > 0 ? customers.findId(ticket.customerId) : nullptr;
+    if (c) c->history.reset();
+}
+
+//reads up to count more of the customer's orders from the log, following the
+//customer index and then each record's link to the one before it
+int loadHistoryPage(Customer* customer, int count) {
+    CustomerHistory& h = customer->history;
+    if (h.complete()) return 0;
+    if (!historyReader.isOpen() && !historyReader.open("order_history", false)) return 0;
+    
+    int added = 0;
+    bool more = false;
+    historyReader.forCustomer(customer->id, [&](const OrderLogRecord& r) {
+        if (added == count) {
+            more = true;    //r starts the next page
+            return false;
         }
+        OrderHistory row;
+        row.orderId = r.orderId;
+        row.orderDate = r.placed;
+        row.totalAmount = r.total;
+        row.itemCount = r.itemCount;
+        h.rows.push_back(row);
+        added++;
+        h.nextOffset = r.prev;
+        return true;
+    }, h.started ? h.nextOffset : -1);
+    if (!more) h.nextOffset = -1;
+    h.started = true;
+    return added;
+}
+
+//one kitchen item per cart line, with its prep time from the drink's category
+vector<KitchenItem> kitchenItems(const vector<CartLine>& lines) {
+    vector<KitchenItem> items;
+    for (size_t i = 0; i < lines.size(); i++) {
+        const DrinkRecord* d = drinkMenu.findById(lines[i].drinkId);
+        KitchenItem it;
+        it.order = 0;
+        it.drinkId = lines[i].drinkId;
+        it.custom = lines[i].custom;
+        it.quantity = lines[i].quantity;
+        it.unitSeconds = estimatePrepSeconds(d ? d->category : "", lines[i].ice(), lines[i].sweet());
+        it.arrival = 0;
+        items.push_back(it);
     }
+    return items;
+}
 
-    //add to history
-    newOrder->next = customer->orderHistory;
-    customer->orderHistory = newOrder;
+//collects finished checkouts without waiting and moves the kitchen along;
+//called before each dashboard
+void processOrderEvents() {
+    double now = kitchenNow();
+    kitchen.advance(now, [](OrderId id, double, double) {
+        char status[160];
+        snprintf(status, sizeof(status), "Order #%lld ready for pickup", (long long)id);
+        orderStatus.push_back(status);
+    });
     
-    //save to file
-    ofstream historyFile("order_history.txt", ios::app);
-    if (historyFile) {
-        char timeStr[20];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&newOrder->orderDate));
-        
-        historyFile << (customer->id ? customer->id : 0) << "|"
-                   << orderId << "|"  //use the provided orderId
-                   << timeStr << "|"
-                   << total << "|"
-                   << itemCount << "|"
-                   << itemDetails << "\n|\n";  
-        
-        historyFile.close();
-        
-        cout << "Order #" << orderId << " saved to history.\n";
-    } else {
-        cerr << "Error: Unable to open order_history.txt for writing!\n";
+    expireCartHolds();
+    
+    OrderEvent<OrderTicket> event;
+    while (orderQueue.poll(event)) {
+        const OrderTicket& t = event.ticket;
+        char status[160];
+        if (event.paid) {
+            recordPaidOrder(t);
+            for (size_t i = 0; i < t.lines.size(); i++) {
+                inventory.commit(t.lines[i].drinkId, t.lines[i].quantity);
+            }
+            kitchen.addOrder(t.id, now, kitchenItems(t.lines));
+            snprintf(status, sizeof(status), "Order #%lld paid (RM %s), sent to the kitchen",
+                     (long long)t.id, formatCents(t.total).c_str());
+        } else {
+            //declined: the items go back into the cart they came from, still reserved
+            int owner = t.owner > 0 ? t.owner : -guestSession;
+            bool keep = cartHolds.count(owner) == 0 || cartHolds[owner].held;
+            for (size_t i = 0; i < t.lines.size(); i++) {
+                const CartLine& line = t.lines[i];
+                if (!keep || recordCartChange(owner, CART_ADD, line.drinkId, line.quantity, line.custom, line.priceCents) == -1) {
+                    inventory.release(line.drinkId, line.quantity);
+                }
+            }
+            snprintf(status, sizeof(status), "Order #%lld not paid: %s - items returned to cart",
+                     (long long)t.id, event.message.c_str());
+        }
+        orderStatus.push_back(status);
+    }
+    if (orderStatus.size() > 3) orderStatus.erase(orderStatus.begin(), orderStatus.end() - 3);
+}
+
+//reads the order log into simulation orders, oldest first
+void loadKitchenOrders(const char* base, vector<KitchenSimOrder>& orders) {
+    OrderLog log;
+    if (!log.open(base, false)) return;
+    
+    map<string, const DrinkRecord*> byName;
+    for (int i = 0; i < drinkMenu.size(); i++) byName[drinkMenu.at(i).name] = &drinkMenu.at(i);
+    map<string, int> unknownIds;   //drinks no longer on the menu still batch by name
+    
+    log.scan([&](const OrderLogRecord& r) {
+        KitchenSimOrder order;
+        order.id = r.orderId;
+        order.arrival = (double)r.placed;
+        for (size_t i = 0; i < r.items.size(); i++) {
+            const OrderLogItem& item = r.items[i];
+            const DrinkRecord* d = drinkMenu.findById(item.drinkId);
+            if (!d && byName.count(item.name)) d = byName[item.name];   //imported from text
+            
+            KitchenItem it;
+            it.order = order.id;
+            if (d) {
+                it.drinkId = d->id;
+            } else {
+                if (!unknownIds.count(item.name)) unknownIds[item.name] = -1 - (int)unknownIds.size();
+                it.drinkId = unknownIds[item.name];
+            }
+            it.custom = Cart::pack(item.ice, item.sweet);
+            it.quantity = item.quantity;
+            it.unitSeconds = estimatePrepSeconds(d ? d->category : "", item.ice, item.sweet);
+            it.arrival = order.arrival;
+            if (it.quantity > 0) order.items.push_back(it);
+        }
+        if (!order.items.empty()) orders.push_back(order);
+        return true;
+    });
+    
+    stable_sort(orders.begin(), orders.end(), [](const KitchenSimOrder& a, const KitchenSimOrder& b) {
+        return a.arrival < b.arrival;
+    });
+}
+
+string waitText(double seconds) {
+    char buf[16];
+    int s = (int)(seconds + 0.5);
+    snprintf(buf, sizeof(buf), "%d:%02d", s / 60, s % 60);
+    return buf;
+}
+
+//--simulate-kitchen [--staff N] [--rate ORDERS_PER_MIN] [--repeat K]
+//replays the order history through FIFO and through the kitchen scheduler for
+//each staff count; the same input always gives the same report
+int simulateKitchenMode(int argc, char* argv[]) {
+    int staffFrom = 1, staffTo = 4, repeat = 1;
+    double rate = 0;   //0 keeps the recorded arrival times
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--staff") == 0) staffFrom = staffTo = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rate") == 0) rate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--repeat") == 0) repeat = atoi(argv[i + 1]);
+    }
+    if (staffFrom < 1) staffFrom = staffTo = 1;
+    if (repeat < 1) repeat = 1;
+    
+    vector<KitchenSimOrder> history;
+    loadKitchenOrders("order_history", history);
+    if (history.empty()) {
+        cout<<"No orders in the order history to simulate\n";
+        return 1;
     }
+    
+    //the history played back to back, optionally respaced to a fixed arrival rate
+    vector<KitchenSimOrder> orders;
+    double span = history.back().arrival - history.front().arrival + 60;
+    for (int k = 0; k < repeat; k++) {
+        for (size_t i = 0; i < history.size(); i++) {
+            KitchenSimOrder o = history[i];
+            o.id = (OrderId)orders.size() + 1;
+            o.arrival = rate > 0 ? orders.size() * 60.0 / rate
+                                 : o.arrival - history.front().arrival + k * span;
+            orders.push_back(o);
+        }
+    }
+    
+    int cups = 0;
+    for (size_t i = 0; i < orders.size(); i++) {
+        for (size_t j = 0; j < orders[i].items.size(); j++) cups += orders[i].items[j].quantity;
+    }
+    cout<<"\nKitchen simulation: " << orders.size() << " orders, " << cups << " drinks";
+    if (rate > 0) cout<<", " << rate << " orders/min\n";
+    else cout<<", recorded arrival times\n";
+    
+    cout<<"+-------+----------------+----------+---------+---------+---------+\n";
+    cout<<"| Staff | Policy         | Drinks/h |   Mean  |   p50   |   p99   |\n";
+    cout<<"+-------+----------------+----------+---------+---------+---------+\n";
+    for (int staff = staffFrom; staff <= staffTo; staff++) {
+        for (int p = 0; p < 2; p++) {
+            KitchenPolicy policy = p == 0 ? KITCHEN_FIFO : KITCHEN_SPF;
+            KitchenSimReport r = simulateKitchen(orders, staff, policy);
+            printf("| %5d | %-14s | %8.0f | %7s | %7s | %7s |\n", staff,
+                   p == 0 ? "FIFO" : "Shortest+batch", r.cupsPerHour,
+                   waitText(r.meanWait).c_str(), waitText(r.p50Wait).c_str(),
+                   waitText(r.p99Wait).c_str());
+        }
+    }
+    cout<<"+-------+----------------+----------+---------+---------+---------+\n";
+    cout<<"Waits are from payment to the whole order being ready (m:ss).\n";
+    return 0;
+}
+
+//cart lines as the service sends them
+void writeServiceCart(ServiceBuffer& out, const Cart& cart) {
+    out.put32(cart.size());
+    for (int i = 0; i < cart.size(); i++) {
+        const CartLine& line = cart.at(i);
+        out.put32(line.drinkId);
+        out.put32(line.priceCents);
+        out.put32(line.quantity);
+        out.put32(line.custom);
+    }
+}
+
+//replaces a local copy of a cart with the lines the service sent, in the same order
+void readServiceCart(ServiceReader& in, Cart& cart) {
+    cart.clear();
+    int count = in.get32();
+    for (int i = 0; in.ok && i < count; i++) {
+        int drinkId = in.get32();
+        int priceCents = in.get32();
+        int quantity = in.get32();
+        int custom = in.get32();
+        if (in.ok) cart.add(drinkId, priceCents, quantity, custom & 0x0F, custom >> 4, MAX_QUANTITY);
+    }
+}
+
+//one request from a kiosk, run on the service's event loop
+int handleServiceRequest(ServiceSession& session, uint16_t type, ServiceReader& in, ServiceBuffer& out) {
+    if (type == SVC_LOGIN) {
+        string email = in.getString();
+        string password = in.getString();
+        Customer* c = customers.findEmail(email.c_str());
+        if (!c && customersChanged()) {
+            loadCustomers();    //registered at a kiosk since the service started
+            c = customers.findEmail(email.c_str());
+        }
+        if (!c || c->isGuest || password != c->password) return SVC_FAILED;
+        session.customerId = c->id;
+        out.put32(c->id);
+        out.putString(c->name);
+        return SVC_OK;
+    }
+    if (type == SVC_MENU) {
+        int64_t known = in.get64();
+        refreshMenu();
+        int64_t version = (int64_t)drinkMenu.getVersion();
+        out.put64(version);
+        int count = known == version ? 0 : drinkMenu.size();
+        out.put32(count);
+        if (count) out.putBytes(drinkMenu.data(), count * sizeof(DrinkRecord));
+        return SVC_OK;
+    }
+    
+    Customer* c = session.customerId > 0 ? customers.findId(session.customerId) : nullptr;
+    if (!c) return SVC_LOGIN_REQUIRED;
+    if (type == SVC_CART_GET) {
+        writeServiceCart(out, c->cart);
+        return SVC_OK;
+    }
+    if (type == SVC_CART_CHANGE) {
+        int op = in.get32();
+        int arg = in.get32();
+        int quantity = in.get32();
+        int custom = in.get32();
+        if (!in.ok || op < CART_ADD || op > CART_CLEAR || quantity < 0 || quantity > MAX_QUANTITY) {
+            return SVC_BAD_REQUEST;
+        }
+        //a line needs at least one cup; ice in the low 4 bits, sweetness above, each 1..3
+        if ((op == CART_ADD || op == CART_SET_QTY) && quantity < 1) return SVC_BAD_REQUEST;
+        int ice = custom & 0x0F, sweet = custom >> 4;
+        if ((op == CART_ADD || op == CART_SET_CUSTOM) && (ice < 1 || ice > 3 || sweet < 1 || sweet > 3)) {
+            return SVC_BAD_REQUEST;
+        }
+        //prices come from the service's menu, never from the kiosk
+        int priceCents = 0;
+        if (op == CART_ADD) {
+            const DrinkRecord* d = drinkMenu.findById(arg);
+            if (!d) return SVC_FAILED;
+            priceCents = d->priceCents;
+        }
+        int result = changeCartFor(c->id, op, arg, quantity, custom, priceCents);
+        out.put32(result);
+        writeServiceCart(out, c->cart);
+        return result == -1 ? SVC_FAILED : SVC_OK;
+    }
+    if (type == SVC_CHECKOUT) {
+        if (c->cart.empty()) {
+            out.putString("Your cart is empty!");
+            return SVC_FAILED;
+        }
+        PriceBatch batch;
+        c->cart.priceInto(batch);
+        Cents total = batch.run();
+        OrderId orderId;
+        string refused;
+        int status = placeOrder(c, total, orderId, refused);
+        if (status != SVC_OK) {
+            out.putString(refused);
+            return status;
+        }
+        recordCartChange(c->id, CART_CLEAR, 0);
+        out.put64(orderId);
+        out.put64(total);
+        return SVC_OK;
+    }
+    return SVC_BAD_REQUEST;
+}
+
+void stopService(int) {
+    serviceStop = true;
+}
+
+//the order service: every kiosk's login, carts and checkout, on one event loop
+int serveOrders(const char* socketPath) {
+    ServiceServer server;
+    if (!server.listen(socketPath)) {
+        cerr << "Error: cannot listen on " << socketPath << "\n";
+        return 1;
+    }
+    signal(SIGINT, stopService);
+    signal(SIGTERM, stopService);
+    cout << "Order service listening on " << socketPath << " (Ctrl+C to stop)\n";
+    
+    server.run(handleServiceRequest, [] {
+        //payments and kitchen progress, as the dashboard would between screens
+        processOrderEvents();
+        for (size_t i = 0; i < orderStatus.size(); i++) cout << orderStatus[i] << "\n";
+        orderStatus.clear();
+    }, [](ServiceSession&) {
+        //the cart stays with the customer; its stock is given back when the hold expires
+    }, serviceStop);
+    
+    cout << "Order service stopped\n";
+    return 0;
+}
+
+//--load-test [kiosks] [seconds] [socket]: 1, 2, 4... up to kiosks simulated kiosks
+//against a running service, logging in as the customers in customers.txt. run
+//the service on a copy of the data, the orders are real
+int loadTestMode(int argc, char* argv[]) {
+    int kiosks = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    const char* socketPath = argc > 4 ? argv[4] : "mixue.sock";
+    
+    vector<ServiceAccount> accounts;
+    for (int i = 1; i < customers.size(); i++) {
+        ServiceAccount a;
+        a.email = customers[i].email;
+        a.password = customers[i].password;
+        accounts.push_back(a);
+    }
+    vector<int> drinkIds;
+    for (int i = 0; i < drinkMenu.size(); i++) drinkIds.push_back(drinkMenu.at(i).id);
+    if (accounts.empty() || drinkIds.empty()) {
+        cerr << "Error: the load test needs customers and drinks on file\n";
+        return 1;
+    }
+    
+    cout << " Kiosks   Requests      Req/s   p50 ms   p99 ms p99.9 ms   max ms  Refused  Failed\n";
+    for (int n = 1; n <= kiosks; n = n < kiosks && n * 2 > kiosks ? kiosks : n * 2) {
+        ServiceLoadResult r = runServiceLoad(socketPath, n, seconds, accounts, drinkIds);
+        if (r.requests == 0) {
+            cerr << "Error: no replies from " << socketPath << ", is --serve running?\n";
+            return 1;
+        }
+        char row[160];
+        snprintf(row, sizeof(row), "%7d %10lld %10.0f %8.3f %8.3f %8.3f %8.3f %8lld %7lld\n", n, (long long)r.requests,
+                 r.perSecond(), r.percentile(50), r.percentile(99), r.percentile(99.9),
+                 r.latencyMs.back(), (long long)r.refused, (long long)r.failures);
+        cout << row;
+        if (n == kiosks) break;
+    }
+    return 0;
+}
+
+//logged in at a kiosk that has an order service: cart changes and checkout go there
+bool usingService() {
+    return orderService.isOpen() && currentCustomer && !currentCustomer->isGuest;
+}
+
+//the service lost: this kiosk carries on with its own files
+void serviceLost() {
+    orderService.close();
+    cerr << "Warning: order service stopped answering, this kiosk now works on its own\n";
+}
+
+//refreshes the local copy of a customer's cart from the service
+bool syncServiceCart(Customer* c) {
+    uint16_t status;
+    string reply;
+    if (!orderService.call(SVC_CART_GET, ServiceBuffer(), status, reply)) {
+        serviceLost();
+        return false;
+    }
+    if (status != SVC_OK) return false;
+    ServiceReader in(reply);
+    readServiceCart(in, c->cart);
+    return true;
+}
+
+//the customer, if the service accepts the password; the local table is reloaded
+//for accounts registered at another kiosk. falls back to the local lookup if
+//the service is gone
+Customer* serviceLogin(const char* email, const char* password) {
+    ServiceBuffer request;
+    request.putString(email);
+    request.putString(password);
+    uint16_t status;
+    string reply;
+    if (!orderService.call(SVC_LOGIN, request, status, reply)) {
+        serviceLost();
+        return customers.findEmail(email);
+    }
+    if (status != SVC_OK) return nullptr;
+    
+    int id = ServiceReader(reply).get32();
+    Customer* c = customers.findId(id);
+    if (!c) {
+        loadCustomers();
+        c = customers.findId(id);
+    }
+    if (c) syncServiceCart(c);
+    return c;
+}
+
+//a cart change made by the service; same result as changeCartFor
+int serviceCartChange(int op, int arg, int quantity, int custom) {
+    ServiceBuffer request;
+    request.put32(op);
+    request.put32(arg);
+    request.put32(quantity);
+    request.put32(custom);
+    uint16_t status;
+    string reply;
+    if (!orderService.call(SVC_CART_CHANGE, request, status, reply)) {
+        serviceLost();
+        return -1;
+    }
+    if (status != SVC_OK && status != SVC_FAILED) return -1;
+    ServiceReader in(reply);
+    int result = in.get32();
+    readServiceCart(in, currentCustomer->cart);
+    return status == SVC_OK ? result : -1;
+}
+
+//checkout by the service; the reply carries the order id and the total it charged
+bool serviceCheckout(OrderId& orderId, Cents& total, string& refused) {
+    uint16_t status;
+    string reply;
+    if (!orderService.call(SVC_CHECKOUT, ServiceBuffer(), status, reply)) {
+        serviceLost();
+        refused = "Payment failed - the order service is not answering";
+        return false;
+    }
+    ServiceReader in(reply);
+    if (status != SVC_OK) {
+        refused = in.getString();
+        if (refused.empty()) refused = "Payment failed";
+        return false;
+    }
+    orderId = in.get64();
+    total = in.get64();
+    return true;
 }
 
 void loginOrRegister() {
-    system("cls");
+    frame.clear();
     cout<<"+=============== ACCOUNT ===============+\n";
     cout<<"| 1. Login                             |\n";
     cout<<"| 2. Register                          |\n";
@@ -885,36 +1884,28 @@ void loginOrRegister() {
         cout<<"| Email: ";
         cin>>email;
         cout<<"| Password: ";
-        cin>>password;
+        {
+            HiddenInput hidden;   //kept out of --record files
+            cin>>password;
+        }
         cout<<"+--------------------------------------+\n";
         
-        for (int i = 0; i < customerCount; i++) {
-            if (strcmp(customers[i].email, email) == 0 && 
-                strcmp(customers[i].password, password) == 0) {
-                currentCustomer = &customers[i];
-                cout<<"| Login successful! Welcome " << customers[i].name << "!\n";
-                cout<<"+--------------------------------------+\n";
-                pressAnyKey();
-                return;
-            }
+        //with an order service the password is checked there and the cart comes from there
+        Customer* c = orderService.isOpen() ? serviceLogin(email, password) : customers.findEmail(email);
+        if (c && !c->isGuest && (orderService.isOpen() || strcmp(c->password, password) == 0)) {
+            currentCustomer = c;
+            cout<<"| Login successful! Welcome " << c->name << "!\n";
+            cout<<"+--------------------------------------+\n";
+            pressAnyKey();
+            return;
         }
         cout<<"| Invalid email or password!            |\n";
         cout<<"+--------------------------------------+\n";
         pressAnyKey();
     }
     else if (choice == 2) {
-        if (customerCount >= MAX_CUSTOMERS) {
-            cout<<"+--------------------------------------+\n";
-            cout<<"| Cannot register more users!          |\n";
-            cout<<"+--------------------------------------+\n";
-            pressAnyKey();
-            return;
-        }
-        
         Customer newCustomer;
-        newCustomer.id = 1000 + customerCount + 1;
-        newCustomer.cart = nullptr;
-        newCustomer.orderHistory = nullptr;
+        newCustomer.isGuest = false;
         
         cout<<"| Name: ";
         cin.ignore();
@@ -925,10 +1916,17 @@ void loginOrRegister() {
         bool validEmail = false;
         do {
             cout<<"| Email (must end with @gmail.com etc): ";
-            cin.getline(newCustomer.email, 100);
+            string emailStr;
+            getline(cin, emailStr);
             cout<<"+--------------------------------------+\n";
             
-            string emailStr(newCustomer.email);
+            //a longer one would be cut short on file and never match at login
+            if (emailStr.size() >= sizeof(newCustomer.email) || emailStr.size() > PROFILE_MAX_EMAIL) {
+                cout<<"| Email is too long!                   |\n";
+                cout<<"+--------------------------------------+\n";
+                continue;
+            }
+            strcpy(newCustomer.email, emailStr.c_str());
             size_t atPos = emailStr.find('@');
             
             if (atPos != string::npos) {
@@ -937,13 +1935,10 @@ void loginOrRegister() {
                     domain == "@outlook.com" || domain == "@email.com") {
                     validEmail = true;
                     
-                    for (int i = 0; i < customerCount; i++) {
-                        if (strcmp(customers[i].email, newCustomer.email) == 0) {
-                            cout<<"| This email is already registered!    |\n";
-                            cout<<"+--------------------------------------+\n";
-                            validEmail = false;
-                            break;
-                        }
+                    if (customers.findEmail(newCustomer.email)) {
+                        cout<<"| This email is already registered!    |\n";
+                        cout<<"+--------------------------------------+\n";
+                        validEmail = false;
                     }
                 }
             }
@@ -958,7 +1953,10 @@ void loginOrRegister() {
         bool validPassword = false;
         do {
             cout<<"| Password (6-10 characters): ";
-            cin.getline(newCustomer.password, 50);
+            {
+                HiddenInput hidden;
+                cin.getline(newCustomer.password, 50);
+            }
             cout<<"+--------------------------------------+\n";
             
             int passLength = strlen(newCustomer.password);
@@ -970,16 +1968,24 @@ void loginOrRegister() {
             }
         } while (!validPassword);
         
-        customers[customerCount] = newCustomer;
-        currentCustomer = &customers[customerCount];
-        customerCount++;
+        //ids after the largest on file, shared with the other kiosks
+        newCustomer.id = customerIds.next(max(1001, customers.largestId() + 1));
+        if (newCustomer.id < 0 || !customers.add(newCustomer)) {
+            cout<<"| Registration failed, please try again|\n";
+            cout<<"+--------------------------------------+\n";
+            pressAnyKey();
+            return;
+        }
+        currentCustomer = &customers.back();
+        appendCustomer(newCustomer);
         
-        // Create customer file (original code unchanged)
-        ofstream customerFile(string(newCustomer.email) + ".txt");
-        customerFile << "Customer ID: " << newCustomer.id << "\n";
-        customerFile << "Name: " << newCustomer.name << "\n";
-        customerFile << "Email: " << newCustomer.email << "\n";
-        customerFile.close();
+        //profile goes to profiles.dat with the next batch
+        Profile profile;
+        profile.customerId = newCustomer.id;
+        profile.email = newCustomer.email;
+        profile.name = newCustomer.name;
+        profile.memberSince = time(0);
+        profiles.put(profile);
         
         cout<<"| Registration successful!           |\n";
         cout<<"+--------------------------------------+\n";
@@ -988,28 +1994,57 @@ void loginOrRegister() {
 }
 
 void viewOrderHistory() {
-    system("cls");
-    cout<<"+=========== ORDER HISTORY ===========+\n";
-    
-    if (!currentCustomer->orderHistory) {
+    if (currentCustomer->isGuest) {
+        frame.clear();
         cout<<"+-----------------------------------+\n";
-        cout<<"| No order history found!           |\n";
+        cout<<"| Log in to see your order history  |\n";
         cout<<"+-----------------------------------+\n";
         pressAnyKey();
         return;
     }
     
-    OrderHistory* current = currentCustomer->orderHistory;
-while (current) {
-    cout<<"+-----------------------------------+\n";
-    cout<<"| Order #" << current->orderId << "\n";
-    cout<<"| Date: " << ctime(&(current->orderDate));
-    cout<<"| Items: " << current->itemCount << "\n";
-    cout<<"| Total: RM " << current->totalAmount << "\n";
-    cout<<"+-----------------------------------+\n";
-    current = current->next;
-}
-pressAnyKey();
+    //orders paid a moment ago may still be queued for the log
+    historyWriter.flush();
+    CustomerHistory& history = currentCustomer->history;
+    int page = 0;
+    while (true) {
+        //pages are read from the log the first time they are shown
+        int first = page * HISTORY_PAGE;
+        if ((int)history.rows.size() < first + HISTORY_PAGE + 1) {
+            loadHistoryPage(currentCustomer, first + HISTORY_PAGE + 1 - (int)history.rows.size());
+        }
+        
+        frame.clear();
+        cout<<"+=========== ORDER HISTORY ===========+\n";
+        if (history.rows.empty()) {
+            cout<<"+-----------------------------------+\n";
+            cout<<"| No order history found!           |\n";
+            cout<<"+-----------------------------------+\n";
+            pressAnyKey();
+            return;
+        }
+        
+        int last = first + HISTORY_PAGE;
+        if (last > (int)history.rows.size()) last = (int)history.rows.size();
+        for (int i = first; i < last; i++) {
+            const OrderHistory& current = history.rows[i];
+            cout<<"+-----------------------------------+\n";
+            cout<<"| Order #" << current.orderId << "\n";
+            cout<<"| Date: " << ctime(&current.orderDate);
+            cout<<"| Items: " << current.itemCount << "\n";
+            cout<<"| Total: RM " << formatCents(current.totalAmount) << "\n";
+            cout<<"+-----------------------------------+\n";
+        }
+        
+        bool hasNext = (int)history.rows.size() > last;
+        cout<<"Page " << page + 1 << (hasNext ? " - N for older orders" : "")
+            << (page > 0 ? ", P for newer orders" : "") << ", 0 to go back: ";
+        string input;
+        cin>>input;
+        if ((input == "n" || input == "N") && hasNext) page++;
+        else if ((input == "p" || input == "P") && page > 0) page--;
+        else if (input == "0") return;
+    }
 }
 
 void viewProfile() {
@@ -1021,11 +2056,23 @@ void viewProfile() {
         return;
     }
     
-    system("cls");
+    //one seek into profiles.dat; accounts without one get it now
+    Profile profile;
+    if (!profiles.get(currentCustomer->email, profile)) {
+        profile.customerId = currentCustomer->id;
+        profile.email = currentCustomer->email;
+        profile.name = currentCustomer->name;
+        profile.memberSince = time(0);
+        profiles.put(profile);
+    }
+    char since[8] = "-";
+    if (profile.memberSince > 0) strftime(since, sizeof(since), "%Y", localtime(&profile.memberSince));
+    
+    frame.clear();
     cout<<"+============= YOUR PROFILE =============+\n";
     cout<<"| Name: " << currentCustomer->name << "\n";
     cout<<"| Email: " << currentCustomer->email << "\n";
-    cout<<"| Member since: 2025\n";
+    cout<<"| Member since: " << since << "\n";
     cout<<"+-------------------------------------+\n";
     cout<<"| 1. Change Name                     |\n";
     cout<<"| 2. Change Password                 |\n";
@@ -1042,6 +2089,9 @@ void viewProfile() {
         char newName[50];
         cin.getline(newName, 50);
         strcpy(currentCustomer->name, newName);
+        profile.name = newName;
+        profiles.put(profile);
+        appendCustomer(*currentCustomer);
         cout<<"+-----------------------------+\n";
         cout<<"| Name updated!              |\n";
         cout<<"+-----------------------------+\n";
@@ -1052,7 +2102,10 @@ void viewProfile() {
         
         // Verify current password
         cout<<"| Current password: ";
-        cin.getline(currentPwd, 50);
+        {
+            HiddenInput hidden;
+            cin.getline(currentPwd, 50);
+        }
         
         if (strcmp(currentPwd, currentCustomer->password) != 0) {
             cout<<"+-----------------------------+\n";
@@ -1066,7 +2119,10 @@ void viewProfile() {
         bool valid = false;
         do {
             cout<<"| New password (6-10 chars): ";
-            cin.getline(newPwd, 50);
+            {
+                HiddenInput hidden;
+                cin.getline(newPwd, 50);
+            }
             
             if (strlen(newPwd) < 6 || strlen(newPwd) > 10) {
                 cout<<"| Password must be 6-10 characters!\n";
@@ -1074,7 +2130,10 @@ void viewProfile() {
             }
             
             cout<<"| Confirm new password: ";
-            cin.getline(confirmPwd, 50);
+            {
+                HiddenInput hidden;
+                cin.getline(confirmPwd, 50);
+            }
             
             if (strcmp(newPwd, confirmPwd) != 0) {
                 cout<<"| Passwords don't match!\n";
@@ -1085,6 +2144,7 @@ void viewProfile() {
         
         // Update password
         strcpy(currentCustomer->password, newPwd);
+        appendCustomer(*currentCustomer);
         cout<<"+-----------------------------+\n";
         cout<<"| Password updated!          |\n";
         cout<<"+-----------------------------+\n";
@@ -1093,75 +2153,104 @@ void viewProfile() {
 }
 
 // Algorithm Implementations 
-void bubbleSortDrinks(int sortBy) {
-    bool swapped;
-    for (int i = 0; i < drinkCount - 1; i++) {
-        swapped = false;
-        for (int j = 0; j < drinkCount - i - 1; j++) {
-            bool shouldSwap = false;
-            
-            if (sortBy == 1) { // Price
-                shouldSwap = drinkMenu[j].price > drinkMenu[j+1].price;
-            } 
-            else if (sortBy == 2) { // Calories
-                shouldSwap = drinkMenu[j].calories > drinkMenu[j+1].calories;
-            }
-            
-            if (shouldSwap) {
-                Drink temp = drinkMenu[j];
-                drinkMenu[j] = drinkMenu[j+1];
-                drinkMenu[j+1] = temp;
-                swapped = true;
-            }
-        }
-        if (!swapped) break;
-    }
-    cout<<"Sort completed!\n";
-    pressAnyKey();
+int compareDrinkId(const DrinkRecord& a, const DrinkRecord& b) {
+    return (a.id > b.id) - (a.id < b.id);
 }
 
-int binarySearchDrink(int id) {
-    int left = 0;
-    int right = drinkCount - 1;
-    
-    while (left <= right) {
-        int mid = left + (right - left) / 2;
-        
-        if (drinkMenu[mid].id == id) {
-            return mid;
-        }
-        
-        if (drinkMenu[mid].id < id) {
-            left = mid + 1;
-        } else {
-            right = mid - 1;
-        }
+int compareDrinkPrice(const DrinkRecord& a, const DrinkRecord& b) {
+    return (a.priceCents > b.priceCents) - (a.priceCents < b.priceCents);
+}
+
+int compareDrinkCalories(const DrinkRecord& a, const DrinkRecord& b) {
+    return (a.calories > b.calories) - (a.calories < b.calories);
+}
+
+int compareDrinkName(const DrinkRecord& a, const DrinkRecord& b) {
+    return strcmp(a.name, b.name);
+}
+
+int compareDrinkCategory(const DrinkRecord& a, const DrinkRecord& b) {
+    return strcmp(a.category, b.category);
+}
+
+//picks the menu sort keys; the catalog itself is never reordered
+void sortMenu(int sortBy) {
+    switch (sortBy) {
+        case 1: menuView.setKeys({compareDrinkPrice, compareDrinkId}); break;
+        case 2: menuView.setKeys({compareDrinkCalories, compareDrinkId}); break;
+        case 5: menuView.setKeys({compareDrinkCategory, compareDrinkPrice, compareDrinkId}); break;
+        case 6: menuView.setKeys({compareDrinkName, compareDrinkId}); break;
+        default: menuView.setKeys({compareDrinkId});
     }
-    return -1;
+}
+
+//current display order of catalog slots, rebuilt only when the catalog changes
+const vector<int>& menuOrder() {
+    return menuView.get(drinkMenu.data(), drinkMenu.size(), drinkMenu.getVersion());
 }
 
 //helper functions 
+void addMenuHeader() {
+    frame.add("ID  | Name                    | Category   | Price  | Calories\n");
+    frame.add("----+-------------------------+------------+--------+----------\n");
+}
+
+//menu rows are formatted once per catalog version and reused on every redraw
+void addMenuRow(int slot) {
+    menuRows.sync(drinkMenu.getVersion(), drinkMenu.size());
+    frame.add(menuRows.get(slot, [](int i, string& out) {
+        const DrinkRecord& d = drinkMenu.at(i);
+        char calories[12] = "-";  //optional sixth csv column
+        if (d.calories > 0) snprintf(calories, sizeof(calories), "%d", (int)d.calories);
+
+        char row[128];
+        snprintf(row, sizeof(row), "%-4d| %-24s| %-11s| RM%-5s| %-9s\n",
+                 (int)d.id,
+                 d.name,
+                 d.category,
+                 formatCents(d.priceCents).c_str(),
+                 calories);
+        out = row;
+    }));
+}
+
+//cart lines only hold the drink id, the name comes from the catalog
+const char* cartLineName(const CartLine& line) {
+    const DrinkRecord* d = drinkMenu.findById(line.drinkId);
+    return d ? d->name : "(unavailable)";
+}
+
+//ice and sweetness choices are 1 regular, 2 less, 3 none
+const char* choiceName(int choice) {
+    static const char* levels[] = {"Regular", "Less", "None"};
+    return (choice >= 1 && choice <= 3) ? levels[choice - 1] : levels[0];
+}
+
+//the search index is built on first use, so startup does not walk the menu
+void ensureDrinkSearch() {
+    if (drinkSearchVersion == drinkMenu.getVersion()) return;
+    drinkSearch.clear();
+    for (int i = 0; i < drinkMenu.size(); i++) {
+        const DrinkRecord& d = drinkMenu.at(i);
+        drinkSearch.put(d.id, {d.name, d.category});
+    }
+    drinkSearchVersion = drinkMenu.getVersion();
+}
+
 void displayDrink(Drink d) {
     cout<<d.name << " (" << d.category << ")";
-    cout<<"   Price: RM " << d.price;
+    cout<<"   Price: RM " << formatCents(d.price);
     cout<<"   Calories: " << d.calories << "\n\n";
 }
 
-float calculateCartTotal() {
-    float total = 0;
-    CartItem* cart = currentCustomer ? currentCustomer->cart : customers[0].cart;
-    CartItem* current = cart;
-    
-    while (current) {
-        total += current->drink.price * current->drink.quantity;
-        current = current->next;
-    }
-    return total;
+//the cart keeps its subtotal up to date, nothing to walk
+Cents calculateCartTotal() {
+    return activeCart().subtotalCents();
 }
 
 void pressAnyKey() {
     cout<<"\nPress any key to continue...";
-    getch();
+    getKey();
 }
 
 //friend functions
@@ -1182,36 +2271,35 @@ void editCart() {
     int returnToView = 1;
 
     do {
-        system("cls");
-        cout<<"+=================================================+\n";
-        cout<<"|                  EDIT YOUR CART                 |\n";
-        cout<<"+=================================================+\n";
-
-        CartItem* cart = currentCustomer ? currentCustomer->cart : customers[0].cart;
-        if (!cart) {
-            cout<<"| Your cart is empty!                             |\n";
-            cout<<"+=================================================+\n";
+        frame.begin(SCREEN_EDIT_CART);
+        frame.add("+=================================================+\n");
+        frame.add("|                  EDIT YOUR CART                 |\n");
+        frame.add("+=================================================+\n");
+
+        Cart& cart = activeCart();
+        if (cart.empty()) {
+            frame.add("| Your cart is empty!                             |\n");
+            frame.add("+=================================================+\n");
+            frame.flush();
             pressAnyKey();
             displayDashboard();
             return;
         }
 
-        int index = 1;
-        CartItem* current = cart;
-		cout<<"\n+-----+-------------------------------+----------+------------+\n";
-		cout<<"| No. | Item                          | Quantity | Total (RM) |\n";
-		cout<<"+-----+-------------------------------+----------+------------+\n";
-        while (current) {
-        printf("| %-3d | %-29s | %-8d | %-10.2f |\n",
-           index++,
-           current->drink.name,
-           current->drink.quantity,  
-           current->drink.price * current->drink.quantity);
-   		   current = current->next;
+		frame.add("\n+-----+-------------------------------+----------+------------+\n");
+		frame.add("| No. | Item                          | Quantity | Total (RM) |\n");
+		frame.add("+-----+-------------------------------+----------+------------+\n");
+        for (int i = 0; i < cart.size(); i++) {
+        frame.addf("| %-3d | %-29s | %-8d | %-10s |\n",
+           i + 1,
+           cartLineName(cart.at(i)),
+           cart.at(i).quantity,  
+           formatCents((Cents)cart.at(i).priceCents * cart.at(i).quantity).c_str());
 			}
-		cout<<"+-----+-------------------------------+----------+------------+\n";
+		frame.add("+-----+-------------------------------+----------+------------+\n");
 
-cout<<"\nEnter item number to edit (0 to return): ";
+frame.add("\nEnter item number to edit (0 to return): ");
+frame.flush();
 int choice;
 cin>>choice;
 
@@ -1220,16 +2308,12 @@ cin>>choice;
             break;
         }
 
-        if (choice > 0 && choice <= index - 1) {
-            current = cart;
-            for (int i = 1; i < choice && current; i++) {
-                current = current->next;
-            }
-
-            if (current) {
-                system("cls");
+        if (choice > 0 && choice <= cart.size()) {
+            int line = choice - 1;
+            if (line < cart.size()) {
+                frame.clear();
                 cout<<"+=====================================+\n";
-                cout<<"| Editing: " << current->drink.name << "\n";
+                cout<<"| Editing: " << cartLineName(cart.at(line)) << "\n";
                 cout<<"+=====================================+\n";
                 cout<<"1. Change quantity\n";
                 cout<<"2. Change customization\n";
@@ -1245,8 +2329,11 @@ cin>>choice;
                         cout<<"Enter new quantity (0-" << MAX_QUANTITY << "): ";
                         cin>>newQty;
                         if (newQty > 0 && newQty <= MAX_QUANTITY) {
-                            current->drink.quantity = newQty;
-                            cout<<"Quantity updated!" << endl;
+                            if (changeCart(CART_SET_QTY, line, newQty) != -1) {
+                                cout<<"Quantity updated!" << endl;
+                            } else {
+                                cout<<"Sorry, not enough stock for " << newQty << "!" << endl;
+                            }
                         } else if (newQty == 0) {
                             removeFromCart(choice);
                             cout<<"Item removed!" << endl;
@@ -1259,12 +2346,12 @@ cin>>choice;
                     case 2: {
                         int customChoice;
                         do {
-                            system("cls");
+                            frame.clear();
                             cout<<"+==============================+\n";
                             cout<<"| Customization Options        |\n";
                             cout<<"+==============================+\n";
-                            cout<<"Current: " << current->drink.iceLevel << " ice, "
-                                 << current->drink.sweetness << " sweet\n\n";
+                            cout<<"Current: " << choiceName(cart.at(line).ice()) << " ice, "
+                                 << choiceName(cart.at(line).sweet()) << " sweet\n\n";
                             cout<<"1. Change ice level\n";
                             cout<<"2. Change sweetness\n";
                             cout<<"0. Finish customization\n";
@@ -1277,8 +2364,7 @@ cin>>choice;
                                 cout<<"Enter choice: ";
                                 cin>>iceChoice;
                                 if (iceChoice >= 1 && iceChoice <= 3) {
-                                    const char* levels[] = {"Regular", "Less", "None"};
-                                    strcpy(current->drink.iceLevel, levels[iceChoice - 1]);
+                                    line = setLineCustom(line, iceChoice, cart.at(line).sweet());
                                 }
                             } else if (customChoice == 2) {
                                 cout<<"\n1. Regular Sweet\n2. Less Sweet\n3. No Sugar\n";
@@ -1286,8 +2372,7 @@ cin>>choice;
                                 cout<<"Enter choice: ";
                                 cin>>sweetChoice;
                                 if (sweetChoice >= 1 && sweetChoice <= 3) {
-                                    const char* levels[] = {"Regular", "Less", "None"};
-                                    strcpy(current->drink.sweetness, levels[sweetChoice - 1]);
+                                    line = setLineCustom(line, cart.at(line).ice(), sweetChoice);
                                 }
                             }
                         } while (customChoice != 0);
@@ -1312,8 +2397,7 @@ cin>>choice;
             pressAnyKey();
         }
 
-        cart = currentCustomer ? currentCustomer->cart : customers[0].cart;
-        if (!cart) {
+        if (activeCart().empty()) {
             returnToView = 0;
             break;
         }
@@ -1325,47 +2409,27 @@ cin>>choice;
 }
 
 
+//a line changed to match another line's customization is merged into it
+int setLineCustom(int line, int ice, int sweet) {
+    int moved = changeCart(CART_SET_CUSTOM, line, 0, ice | (sweet << 4));
+    if (moved == -1) {
+        cout<<"Max " << MAX_QUANTITY << " of the same drink per line!\n";
+        pressAnyKey();
+        return line;
+    }
+    return moved;
+}
+
 void showCartInterface() {
     while(viewCart()) {
     }
 }
 
-int generateUniqueOrderId() {
-    // Start with current order counter
-    int newId = orderCounter;
-    
-    // Check if ID already exists in history file
-    ifstream historyFile("order_history.txt");
-    if (historyFile) {
-        set<int> existingIds;
-        string line;
-        
-        while (getline(historyFile, line)) {
-            // Extract order ID from each line (format: customerID|orderID|...)
-            size_t pipePos = line.find('|', line.find('|') + 1);
-            if (pipePos != string::npos) {
-                try {
-                    int existingId = stoi(line.substr(pipePos, line.find('|', pipePos) - pipePos));
-                    existingIds.insert(existingId);
-                } catch (...) {
-                    continue; // Skip invalid entries
-                }
-            }
-        }
-        historyFile.close();
-
-        // Find next available ID
-        while (existingIds.count(newId)) {
-            newId++;
-            if (newId > 9999) newId = 1001; // Wrap around
-            if (newId == orderCounter) { // Full loop completed
-                cerr << "Error: No available order IDs!\n";
-                return -1;
-            }
-        }
+//ids come from blocks reserved in order_seq.dat, the history is never read
+OrderId generateUniqueOrderId() {
+    OrderId newId = orderIds.next();
+    if (newId == -1) {
+        cerr << "Error: Unable to update order_seq.dat!\n";
     }
-
-    // Update counter for next order
-    orderCounter = (newId >= 9999) ? 1001 : newId + 1;
     return newId;
 }
@@ -0,0 +1,255 @@
+#ifndef CART_JOURNAL_H
+#define CART_JOURNAL_H
+
+//append-only journal of cart changes, so carts survive a restart or crash.
+//every change is a fixed 20-byte record; records are buffered and written in
+//groups, and a flusher thread syncs them to disk within syncIntervalMs, so
+//the last change before the kiosk goes idle is not left unsynced. a checkpoint holds
+//the full state of every cart as the same kind of records, tagged with a
+//generation; only a journal of the checkpoint's generation is replayed on top.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+enum CartOp {
+    CART_ADD = 1,        //arg = drink id, merged like Cart::add
+    CART_SET_QTY,        //arg = line index
+    CART_SET_CUSTOM,     //arg = line index
+    CART_REMOVE,         //arg = line index
+    CART_CLEAR,
+    CART_GUEST_SESSION   //owner = the new guest session's owner id
+};
+
+struct CartRecord {
+    uint8_t op;
+    uint8_t custom;      //packed ice/sweetness, as in CartLine
+    uint16_t quantity;
+    int32_t owner;       //customer id, or a negative guest session id
+    int32_t arg;
+    int32_t priceCents;
+    uint32_t check;      //over the fields above, catches torn writes
+};
+
+struct CartFileHeader {
+    char magic[8];
+    uint32_t generation;
+    uint32_t count;      //records that follow, checkpoints only
+};
+
+inline uint32_t cartRecordCheck(const CartRecord& r) {
+    //FNV-1a over the first 16 bytes
+    const unsigned char* p = (const unsigned char*)&r;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < offsetof(CartRecord, check); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+class CartJournal {
+private:
+    FILE* file;
+    std::string journalPath;
+    std::string checkpointPath;
+    uint32_t generation;
+    std::vector<CartRecord> pending;   //appended but not yet written
+    int written;                        //records in the journal file
+    bool unsynced;                      //written but not yet flushed to disk
+    std::mutex lock;                    //file and unsynced, shared with the flusher
+    std::condition_variable wake;
+    std::thread flusher;
+    bool stopping;
+
+    static void syncFile(FILE* f) {
+        fflush(f);
+#ifdef _WIN32
+        _commit(_fileno(f));
+#else
+        fsync(fileno(f));
+#endif
+    }
+
+    static bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    //reads whole records until the end or the first torn/corrupt one
+    template <typename F>
+    static int readRecords(FILE* f, int limit, F apply) {
+        int n = 0;
+        CartRecord r;
+        while ((limit < 0 || n < limit) && fread(&r, sizeof(r), 1, f) == 1) {
+            if (r.check != cartRecordCheck(r)) break;
+            apply(r);
+            n++;
+        }
+        return n;
+    }
+
+    //syncs what commit() wrote, at most syncIntervalMs after it was written
+    void flushLoop() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!stopping) {
+            wake.wait(guard, [&] { return stopping || unsynced; });
+            if (!stopping) wake.wait_for(guard, std::chrono::milliseconds(syncIntervalMs), [&] { return stopping; });
+            if (file && unsynced) {
+                syncFile(file);
+                unsynced = false;
+            }
+        }
+    }
+
+    //under the lock
+    bool startJournal() {
+        if (file) fclose(file);
+        file = fopen(journalPath.c_str(), "wb");
+        if (!file) return false;
+        CartFileHeader h;
+        memcpy(h.magic, "CARTJRNL", 8);
+        h.generation = generation;
+        h.count = 0;
+        fwrite(&h, sizeof(h), 1, file);
+        syncFile(file);
+        written = 0;
+        unsynced = false;
+        if (!flusher.joinable()) flusher = std::thread([this] { flushLoop(); });
+        return true;
+    }
+
+public:
+    int checkpointEvery;   //journal records before a checkpoint is due
+    int syncIntervalMs;    //longest a written record waits for a disk flush
+
+    CartJournal() : file(nullptr), generation(0), written(0), unsynced(false), stopping(false),
+                    checkpointEvery(4096), syncIntervalMs(100) {}
+
+    ~CartJournal() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (flusher.joinable()) flusher.join();
+        if (file) {
+            commit();
+            syncFile(file);
+            fclose(file);
+        }
+    }
+
+    //replays the last checkpoint and the journal after it through apply(record);
+    //the caller then writes a fresh checkpoint, which also drops any torn tail
+    template <typename F>
+    int open(const char* journal, const char* checkpoint, F apply) {
+        journalPath = journal;
+        checkpointPath = checkpoint;
+        generation = 0;
+        int replayed = 0;
+
+        FILE* in = fopen(checkpoint, "rb");
+        if (in) {
+            CartFileHeader h;
+            if (fread(&h, sizeof(h), 1, in) == 1 && memcmp(h.magic, "CARTCKPT", 8) == 0) {
+                //a short checkpoint was never renamed into place, so this reads it all
+                generation = h.generation;
+                replayed += readRecords(in, (int)h.count, apply);
+            }
+            fclose(in);
+        }
+
+        in = fopen(journal, "rb");
+        if (in) {
+            CartFileHeader h;
+            //a journal from an older generation is already inside the checkpoint
+            if (fread(&h, sizeof(h), 1, in) == 1 && memcmp(h.magic, "CARTJRNL", 8) == 0 &&
+                h.generation == generation) {
+                replayed += readRecords(in, -1, apply);
+            }
+            fclose(in);
+        }
+        return replayed;
+    }
+
+    void append(CartRecord r) {
+        r.check = cartRecordCheck(r);
+        pending.push_back(r);
+    }
+
+    //writes every pending record in one call; the flusher syncs them, one disk
+    //flush for all records written within syncIntervalMs of each other
+    void commit() {
+        bool wrote = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!file || pending.empty()) return;
+            fwrite(pending.data(), sizeof(CartRecord), pending.size(), file);
+            fflush(file);   //in the OS now, survives the program crashing
+            written += (int)pending.size();
+            pending.clear();
+            wrote = !unsynced;
+            unsynced = true;
+        }
+        if (wrote) wake.notify_all();
+    }
+
+    bool checkpointDue() const {
+        return written >= checkpointEvery;
+    }
+
+    //writes the complete cart state from state(records) as a new checkpoint, then
+    //starts an empty journal for the next generation
+    template <typename F>
+    bool checkpoint(F state) {
+        std::vector<CartRecord> records;
+        state(records);
+        for (size_t i = 0; i < records.size(); i++) {
+            records[i].check = cartRecordCheck(records[i]);
+        }
+
+        std::string tmpPath = checkpointPath + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "wb");
+        if (!out) return false;
+        CartFileHeader h;
+        memcpy(h.magic, "CARTCKPT", 8);
+        h.generation = generation + 1;
+        h.count = (uint32_t)records.size();
+        bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+        if (!records.empty()) {
+            ok = ok && fwrite(records.data(), sizeof(CartRecord), records.size(), out) == records.size();
+        }
+        syncFile(out);
+        fclose(out);
+        if (!ok || !replaceFile(tmpPath, checkpointPath)) {
+            remove(tmpPath.c_str());
+            return false;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        generation++;
+        pending.clear();
+        return startJournal();
+    }
+
+    bool isOpen() const { return file != nullptr; }
+    int journalRecords() const { return written; }
+};
+
+#endif
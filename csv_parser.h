@@ -0,0 +1,329 @@
+#ifndef CSV_PARSER_H
+#define CSV_PARSER_H
+
+//one csv reader for every data file. the file is mapped (or read in one go
+//where it cannot be), line ends and commas are found 16 bytes at a time with
+//SSE2, and fields are string_views into the buffer, so a row costs no
+//allocation once the field vector has grown. numbers are converted straight
+//from the view. a malformed line is recorded with its line number and byte
+//offset and skipped by the caller; nothing throws. fields are split on every
+//comma with no quoting, as none of the files quote.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "money.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CSV_PARSER_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct CsvError {
+    size_t line;        //1-based; 0 for a row from the table's journal
+    size_t offset;      //byte offset of the line in the file, or of the record in the journal
+    std::string message;
+};
+
+//index of the lowest set bit of a non-zero mask
+inline int csvLowestBit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return (int)bit;
+#elif defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while (!(mask & (1u << bit))) bit++;
+    return bit;
+#endif
+}
+
+//first a or b in [p, end), or end
+inline const char* csvFind(const char* p, const char* end, char a, char b) {
+#ifdef CSV_PARSER_SSE2
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)));
+        if (mask) return p + csvLowestBit((unsigned)mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != a && *p != b) p++;
+    return p;
+}
+
+//line without a trailing '\r'
+inline std::string_view csvStripCr(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return line;
+}
+
+//splits one line on commas; fields point into line
+inline void csvSplit(std::string_view line, std::vector<std::string_view>& fields) {
+    fields.clear();
+    line = csvStripCr(line);
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while (true) {
+        const char* comma = csvFind(p, end, ',', ',');
+        fields.push_back(std::string_view(p, (size_t)(comma - p)));
+        if (comma == end) break;
+        p = comma + 1;
+    }
+}
+
+inline std::string_view csvTrim(std::string_view s) {
+    while (!s.empty() && s.front() == ' ') s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+//decimal int32 with optional sign and surrounding spaces; false on anything
+//else, including overflow
+inline bool csvToInt(std::string_view s, int32_t& out) {
+    s = csvTrim(s);
+    bool negative = !s.empty() && s.front() == '-';
+    if (negative || (!s.empty() && s.front() == '+')) s.remove_prefix(1);
+    if (s.empty() || s.size() > 10) return false;
+    int64_t v = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    if (negative) v = -v;
+    if (v < INT32_MIN || v > INT32_MAX) return false;
+    out = (int32_t)v;
+    return true;
+}
+
+//a price column, see parseCents in money.h
+inline bool csvToCents(std::string_view s, Cents& out) {
+    char buf[32];
+    if (s.size() >= sizeof(buf)) return false;
+    memcpy(buf, s.data(), s.size());
+    buf[s.size()] = '\0';
+    return parseCents(buf, out);
+}
+
+//copies a field into a fixed char[] column, cut to fit and terminated
+inline void csvCopy(char* dest, size_t size, std::string_view field) {
+    size_t n = field.size() < size - 1 ? field.size() : size - 1;
+    memcpy(dest, field.data(), n);
+    dest[n] = '\0';
+}
+
+//a whole file, mapped read-only or read into memory
+class CsvFile {
+private:
+    const char* base;
+    size_t length;
+    std::vector<char> owned;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mapHandle;
+#endif
+
+public:
+    CsvFile() : base(nullptr), length(0) {
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mapHandle = NULL;
+#endif
+    }
+
+    ~CsvFile() {
+        close();
+    }
+
+    //false if the file cannot be opened; an empty file is open with size 0
+    bool open(const char* path) {
+        close();
+        FILE* f = fopen(path, "rb");
+        if (!f) return false;
+#ifdef _WIN32
+        fclose(f);
+        f = nullptr;
+        fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        GetFileSizeEx(fileHandle, &size);
+        length = (size_t)size.QuadPart;
+        mapHandle = length ? CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        base = mapHandle ? (const char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!base) {
+            length = 0;
+            f = fopen(path, "rb");
+        }
+#else
+        struct stat st;
+        if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+            length = (size_t)st.st_size;
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+            base = (p == MAP_FAILED) ? nullptr : (const char*)p;
+            if (base) madvise(p, length, MADV_SEQUENTIAL);
+        }
+#endif
+        if (!base && f) {
+            //not mappable (empty, a pipe...): read it in one go
+            owned.clear();
+            char chunk[65536];
+            size_t n;
+            while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) owned.insert(owned.end(), chunk, chunk + n);
+            length = owned.size();
+            base = owned.empty() ? "" : &owned[0];
+        }
+        if (f) fclose(f);
+        return true;
+    }
+
+    void close() {
+        if (base && owned.empty() && length) {
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+#else
+            munmap((void*)base, length);
+#endif
+        }
+#ifdef _WIN32
+        if (mapHandle) CloseHandle(mapHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mapHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#endif
+        owned.clear();
+        base = nullptr;
+        length = 0;
+    }
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+//lines and fields of a buffer, in order
+class CsvParser {
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+    const char* lineStart;
+    size_t lineNo;
+
+public:
+    std::vector<CsvError> errors;
+
+    CsvParser(const char* data, size_t size)
+        : begin(data), p(data), end(data + size), lineStart(data), lineNo(0) {}
+
+    //the next non-empty line without its line ending; false at the end
+    bool nextLine(std::string_view& line) {
+        while (p < end) {
+            const char* eol = csvFind(p, end, '\n', '\n');
+            lineStart = p;
+            lineNo++;
+            line = csvStripCr(std::string_view(p, (size_t)(eol - p)));
+            p = eol < end ? eol + 1 : end;
+            if (!line.empty()) return true;
+        }
+        return false;
+    }
+
+    //the next non-empty line split into fields, in one pass over its bytes
+    bool next(std::vector<std::string_view>& fields) {
+        while (p < end) {
+            fields.clear();
+            lineStart = p;
+            lineNo++;
+            const char* field = p;
+            while (true) {
+                const char* hit = csvFind(p, end, ',', '\n');
+                if (hit < end && *hit == ',') {
+                    fields.push_back(std::string_view(field, (size_t)(hit - field)));
+                    p = field = hit + 1;
+                    continue;
+                }
+                fields.push_back(csvStripCr(std::string_view(field, (size_t)(hit - field))));
+                p = hit < end ? hit + 1 : end;
+                break;
+            }
+            if (fields.size() > 1 || !fields[0].empty()) return true;
+        }
+        return false;
+    }
+
+    size_t line() const { return lineNo; }
+    size_t offset() const { return (size_t)(lineStart - begin); }
+
+    //records the current line as malformed
+    void reject(const std::string& why) {
+        CsvError e;
+        e.line = lineNo;
+        e.offset = offset();
+        e.message = why;
+        errors.push_back(e);
+    }
+};
+
+//one row of a table and where it came from, see table_journal.h
+struct CsvRow {
+    std::string_view text;
+    size_t line;        //in the base file, 0 for a row from the journal
+    size_t offset;      //of the line in the base, or of the record in the journal
+};
+
+//fields of the rows of a table read through table_journal.h, one row at a
+//time; errors carry each row's own position
+class CsvRowParser {
+private:
+    const std::vector<CsvRow>& rows;
+    size_t index;
+
+public:
+    std::vector<CsvError> errors;
+
+    explicit CsvRowParser(const std::vector<CsvRow>& tableRows) : rows(tableRows), index(0) {}
+
+    bool next(std::vector<std::string_view>& fields) {
+        if (index >= rows.size()) return false;
+        csvSplit(rows[index++].text, fields);
+        return true;
+    }
+
+    size_t line() const { return index ? rows[index - 1].line : 0; }
+    size_t offset() const { return index ? rows[index - 1].offset : 0; }
+
+    void reject(const std::string& why) {
+        CsvError e;
+        e.line = line();
+        e.offset = offset();
+        e.message = why;
+        errors.push_back(e);
+    }
+};
+
+//one line per malformed row: "customers.txt:12 (byte 345): bad id", or
+//"customers.txt.journal (byte 96): bad id" for a row from the journal
+inline void csvReport(FILE* out, const char* path, const std::vector<CsvError>& errors) {
+    for (size_t i = 0; i < errors.size(); i++) {
+        const CsvError& e = errors[i];
+        if (e.line) fprintf(out, "%s:%zu (byte %zu): %s\n", path, e.line, e.offset, e.message.c_str());
+        else fprintf(out, "%s.journal (byte %zu): %s\n", path, e.offset, e.message.c_str());
+    }
+}
+
+#endif
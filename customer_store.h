@@ -0,0 +1,71 @@
+#ifndef CUSTOMER_STORE_H
+#define CUSTOMER_STORE_H
+
+//customer table without a fixed size or linear lookups: rows live in a deque
+//(pointers to a customer stay valid as more register) with hash indexes on
+//email and id, so login, duplicate checks and cart owner lookups cost the same
+//for any number of accounts. new ids come from a shared sequence file
+//(order_id.h) that is never below the largest id already on file, so they do
+//not collide with ids given out by hand or by another kiosk.
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include "order_id.h"
+
+//T needs an int id and a char email[]
+template <typename T>
+class CustomerStore {
+private:
+    std::deque<T> rows;
+    std::unordered_map<std::string, size_t> byEmail;
+    std::unordered_map<int, size_t> byId;
+    int maxId;
+
+public:
+    CustomerStore() : maxId(0) {}
+
+    //adds a row; false (nothing added) if the email or id is taken
+    bool add(const T& c) {
+        if (byEmail.count(c.email) || byId.count(c.id)) return false;
+        byEmail[c.email] = rows.size();
+        byId[c.id] = rows.size();
+        rows.push_back(c);
+        if (c.id > maxId) maxId = c.id;
+        return true;
+    }
+
+    T* findEmail(const char* email) {
+        std::unordered_map<std::string, size_t>::iterator it = byEmail.find(email);
+        return it == byEmail.end() ? nullptr : &rows[it->second];
+    }
+
+    T* findId(int id) {
+        std::unordered_map<int, size_t>::iterator it = byId.find(id);
+        return it == byId.end() ? nullptr : &rows[it->second];
+    }
+
+    T& operator[](size_t i) { return rows[i]; }
+    const T& operator[](size_t i) const { return rows[i]; }
+    int size() const { return (int)rows.size(); }
+    T& back() { return rows.back(); }
+    int largestId() const { return maxId; }
+};
+
+//customer ids from a sequence file shared by every kiosk
+class CustomerIdGenerator {
+private:
+    std::string path;
+
+public:
+    void open(const char* seqPath) { path = seqPath; }
+
+    //the next unused id, at least floor; -1 if the sequence file cannot be updated
+    int next(int floor) {
+        int64_t id = reserveSequence(path, 1, floor);
+        return (id < 0 || id > 2000000000) ? -1 : (int)id;
+    }
+};
+
+#endif
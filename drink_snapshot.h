@@ -0,0 +1,429 @@
+#ifndef DRINK_SNAPSHOT_H
+#define DRINK_SNAPSHOT_H
+
+//binary snapshot of mixue.txt shared by the customer and admin programs.
+//mixue.txt stays the interchange format: id,name,category,price,stock[,calories]
+//mixue.bin is rebuilt from it (with mixue.txt.journal applied, see
+//table_journal.h) whenever either file's size or mtime changes, and is mapped
+//read-only so startup does not parse the menu.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "money.h"
+#include "table_journal.h"
+#include "csv_parser.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+const uint32_t SNAPSHOT_VERSION = 1;
+
+//one drink, every csv column; fixed size so the file can be used in place
+struct DrinkRecord {
+    int32_t id;
+    char name[50];
+    char category[30];
+    int32_t priceCents;
+    int32_t stock;
+    int32_t calories;
+};
+
+enum SnapshotColumnType { COL_INT32 = 1, COL_CHARS = 2 };
+
+struct SnapshotColumn {
+    char name[16];
+    uint32_t type;
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct SnapshotCategory {
+    char name[30];
+    uint32_t first;  //index into the category slot list
+    uint32_t count;
+};
+
+struct SnapshotHeader {
+    char magic[8];            //"MIXUEBIN"
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t columnCount;     //SnapshotColumn entries follow the header
+    uint32_t categoryCount;
+    uint64_t recordCount;
+    uint64_t sourceSize;      //mixue.txt fingerprint
+    int64_t sourceMtime;
+    uint64_t recordsOffset;
+    uint64_t idTableOffset;   //int32 slots, open addressing, -1 = empty
+    uint64_t idTableSize;     //power of two
+    uint64_t categoriesOffset;
+    uint64_t categorySlotsOffset;
+    uint64_t fileSize;
+};
+
+inline unsigned snapshotHashId(int id) {
+    return (unsigned)id * 2654435761u;
+}
+
+//parses mixue.txt and its journal into records; malformed rows are skipped
+//and, when errors is given, listed there
+inline bool readDrinkCsv(const char* csvPath, std::vector<DrinkRecord>& out,
+                         std::vector<CsvError>* errors = nullptr) {
+    TableRows table;
+    if (!readTable(csvPath, table)) return false;
+
+    CsvRowParser parser(table.rows);
+    std::vector<std::string_view> cols;
+    while (parser.next(cols)) {
+        if (cols.size() < 5) {
+            parser.reject("expected at least 5 columns");
+            continue;
+        }
+
+        DrinkRecord r;
+        memset(&r, 0, sizeof(r));
+        Cents price;
+        if (!csvToInt(cols[0], r.id)) {
+            parser.reject("bad id");
+            continue;
+        }
+        if (!csvToCents(cols[3], price) || price > INT32_MAX) {
+            parser.reject("bad price");
+            continue;
+        }
+        if (!csvToInt(cols[4], r.stock)) {
+            parser.reject("bad stock");
+            continue;
+        }
+        if (cols.size() > 5 && !csvTrim(cols[5]).empty() && !csvToInt(cols[5], r.calories)) {
+            parser.reject("bad calories");
+            continue;
+        }
+        r.priceCents = (int32_t)price;
+        csvCopy(r.name, sizeof(r.name), cols[1]);
+        csvCopy(r.category, sizeof(r.category), cols[2]);
+        out.push_back(r);
+    }
+    if (errors) errors->insert(errors->end(), parser.errors.begin(), parser.errors.end());
+    return true;
+}
+
+//lays out a complete snapshot image; later records with a repeated id win
+inline void buildSnapshotImage(const std::vector<DrinkRecord>& input, uint64_t sourceSize,
+                               int64_t sourceMtime, std::vector<char>& image) {
+    static const SnapshotColumn columns[] = {
+        {"id", COL_INT32, offsetof(DrinkRecord, id), 4},
+        {"name", COL_CHARS, offsetof(DrinkRecord, name), sizeof(((DrinkRecord*)0)->name)},
+        {"category", COL_CHARS, offsetof(DrinkRecord, category), sizeof(((DrinkRecord*)0)->category)},
+        {"price_cents", COL_INT32, offsetof(DrinkRecord, priceCents), 4},
+        {"stock", COL_INT32, offsetof(DrinkRecord, stock), 4},
+        {"calories", COL_INT32, offsetof(DrinkRecord, calories), 4},
+    };
+    const uint32_t columnCount = sizeof(columns) / sizeof(columns[0]);
+
+    //dedupe by id through the same table the reader uses
+    std::vector<DrinkRecord> records;
+    uint64_t tableSize = 64;
+    while (tableSize < input.size() * 2) tableSize *= 2;
+    std::vector<int32_t> idTable(tableSize, -1);
+    for (size_t i = 0; i < input.size(); i++) {
+        unsigned pos = snapshotHashId(input[i].id) & (unsigned)(tableSize - 1);
+        while (idTable[pos] != -1 && records[idTable[pos]].id != input[i].id) {
+            pos = (pos + 1) & (unsigned)(tableSize - 1);
+        }
+        if (idTable[pos] != -1) {
+            records[idTable[pos]] = input[i];
+        } else {
+            idTable[pos] = (int32_t)records.size();
+            records.push_back(input[i]);
+        }
+    }
+
+    //categories in first-seen order, each with its slots in record order
+    std::vector<SnapshotCategory> categories;
+    std::vector<std::vector<uint32_t>> members;
+    for (size_t i = 0; i < records.size(); i++) {
+        size_t c = 0;
+        while (c < categories.size() && strncmp(categories[c].name, records[i].category, 30) != 0) c++;
+        if (c == categories.size()) {
+            SnapshotCategory cat;
+            memset(&cat, 0, sizeof(cat));
+            memcpy(cat.name, records[i].category, sizeof(cat.name));
+            categories.push_back(cat);
+            members.push_back(std::vector<uint32_t>());
+        }
+        members[c].push_back((uint32_t)i);
+    }
+    std::vector<uint32_t> categorySlots;
+    for (size_t c = 0; c < categories.size(); c++) {
+        categories[c].first = (uint32_t)categorySlots.size();
+        categories[c].count = (uint32_t)members[c].size();
+        categorySlots.insert(categorySlots.end(), members[c].begin(), members[c].end());
+    }
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "MIXUEBIN", 8);
+    h.version = SNAPSHOT_VERSION;
+    h.recordSize = sizeof(DrinkRecord);
+    h.columnCount = columnCount;
+    h.categoryCount = (uint32_t)categories.size();
+    h.recordCount = records.size();
+    h.sourceSize = sourceSize;
+    h.sourceMtime = sourceMtime;
+    h.recordsOffset = (sizeof(h) + sizeof(columns) + 7) & ~7ull;
+    h.idTableOffset = h.recordsOffset + records.size() * sizeof(DrinkRecord);
+    h.idTableSize = tableSize;
+    h.categoriesOffset = h.idTableOffset + tableSize * sizeof(int32_t);
+    h.categorySlotsOffset = h.categoriesOffset + categories.size() * sizeof(SnapshotCategory);
+    h.fileSize = h.categorySlotsOffset + categorySlots.size() * sizeof(uint32_t);
+
+    image.assign((size_t)h.fileSize, 0);
+    memcpy(&image[0], &h, sizeof(h));
+    memcpy(&image[sizeof(h)], columns, sizeof(columns));
+    if (!records.empty()) memcpy(&image[h.recordsOffset], &records[0], records.size() * sizeof(DrinkRecord));
+    memcpy(&image[h.idTableOffset], &idTable[0], tableSize * sizeof(int32_t));
+    if (!categories.empty()) {
+        memcpy(&image[h.categoriesOffset], &categories[0], categories.size() * sizeof(SnapshotCategory));
+        memcpy(&image[h.categorySlotsOffset], &categorySlots[0], categorySlots.size() * sizeof(uint32_t));
+    }
+}
+
+//writes binPath from csvPath through a temp file and rename, so readers never see half a file
+inline bool buildDrinkSnapshot(const char* csvPath, const char* binPath) {
+    uint64_t size;
+    int64_t mtime;
+    std::vector<DrinkRecord> records;
+    std::vector<CsvError> errors;
+    if (!tableFingerprint(csvPath, size, mtime) || !readDrinkCsv(csvPath, records, &errors)) return false;
+    csvReport(stderr, csvPath, errors);   //once per change of the file, not per start
+
+    std::vector<char> image;
+    buildSnapshotImage(records, size, mtime, image);
+
+    std::string tmpPath = std::string(binPath) + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "wb");
+    if (!out) return false;
+    bool ok = fwrite(&image[0], 1, image.size(), out) == image.size();
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    if (!MoveFileExA(tmpPath.c_str(), binPath, MOVEFILE_REPLACE_EXISTING)) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+#else
+    if (rename(tmpPath.c_str(), binPath) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+#endif
+    return true;
+}
+
+//read-only view of a snapshot, either mapped from disk or held in memory
+class DrinkSnapshot {
+private:
+    const char* base;
+    size_t length;
+    std::vector<char> owned;  //used when the file could not be written or mapped
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mapHandle;
+#endif
+
+    const SnapshotHeader* header() const { return (const SnapshotHeader*)base; }
+
+    //checks the header and that every column sits where DrinkRecord expects it
+    bool validate() const {
+        if (!base || length < sizeof(SnapshotHeader)) return false;
+        const SnapshotHeader* h = header();
+        if (memcmp(h->magic, "MIXUEBIN", 8) != 0 || h->version != SNAPSHOT_VERSION) return false;
+        if (h->recordSize != sizeof(DrinkRecord) || h->fileSize != length) return false;
+        if (sizeof(SnapshotHeader) + h->columnCount * sizeof(SnapshotColumn) > length) return false;
+
+        const SnapshotColumn* cols = (const SnapshotColumn*)(base + sizeof(SnapshotHeader));
+        const char* expected[] = {"id", "name", "category", "price_cents", "stock", "calories"};
+        const uint32_t offsets[] = {offsetof(DrinkRecord, id), offsetof(DrinkRecord, name),
+                                    offsetof(DrinkRecord, category), offsetof(DrinkRecord, priceCents),
+                                    offsetof(DrinkRecord, stock), offsetof(DrinkRecord, calories)};
+        for (int i = 0; i < 6; i++) {
+            bool found = false;
+            for (uint32_t c = 0; c < h->columnCount; c++) {
+                if (strncmp(cols[c].name, expected[i], 16) == 0 && cols[c].offset == offsets[i]) found = true;
+            }
+            if (!found) return false;
+        }
+        if (h->idTableSize == 0 || (h->idTableSize & (h->idTableSize - 1)) != 0) return false;
+        if (h->idTableSize <= h->recordCount) return false;   //lookups stop at an empty slot
+
+        //every section inside the mapping, so a truncated or stale file is rebuilt
+        //instead of read past its end
+        if (!fits(h->recordsOffset, h->recordCount, sizeof(DrinkRecord)) ||
+            !fits(h->idTableOffset, h->idTableSize, sizeof(int32_t)) ||
+            !fits(h->categoriesOffset, h->categoryCount, sizeof(SnapshotCategory)) ||
+            h->categorySlotsOffset > length) {
+            return false;
+        }
+        uint64_t slotCount = (length - h->categorySlotsOffset) / sizeof(uint32_t);
+
+        const int32_t* table = (const int32_t*)(base + h->idTableOffset);
+        for (uint64_t i = 0; i < h->idTableSize; i++) {
+            if (table[i] < -1 || (table[i] >= 0 && (uint64_t)table[i] >= h->recordCount)) return false;
+        }
+        const SnapshotCategory* categories = (const SnapshotCategory*)(base + h->categoriesOffset);
+        const uint32_t* slots = (const uint32_t*)(base + h->categorySlotsOffset);
+        for (uint32_t c = 0; c < h->categoryCount; c++) {
+            if ((uint64_t)categories[c].first + categories[c].count > slotCount) return false;
+        }
+        for (uint64_t i = 0; i < slotCount; i++) {
+            if (slots[i] >= h->recordCount) return false;
+        }
+        return true;
+    }
+
+    //count items of size bytes at offset lie inside the mapping, without overflow
+    bool fits(uint64_t offset, uint64_t count, uint64_t size) const {
+        if (offset > length || (offset & 3) != 0) return false;
+        return count <= (length - offset) / size;
+    }
+
+public:
+    DrinkSnapshot() : base(nullptr), length(0) {
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mapHandle = NULL;
+#endif
+    }
+
+    ~DrinkSnapshot() {
+        close();
+    }
+
+    void close() {
+        if (base && owned.empty()) {
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+            if (mapHandle) CloseHandle(mapHandle);
+            if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+            mapHandle = NULL;
+            fileHandle = INVALID_HANDLE_VALUE;
+#else
+            munmap((void*)base, length);
+#endif
+        }
+        owned.clear();
+        base = nullptr;
+        length = 0;
+    }
+
+    bool mapFile(const char* binPath) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(binPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        GetFileSizeEx(fileHandle, &size);
+        length = (size_t)size.QuadPart;
+        mapHandle = length ? CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+        base = mapHandle ? (const char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        FILE* f = fopen(binPath, "rb");
+        if (!f) return false;
+        struct stat st;
+        if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+            length = (size_t)st.st_size;
+            void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fileno(f), 0);
+            base = (p == MAP_FAILED) ? nullptr : (const char*)p;
+        }
+        fclose(f);  //the mapping stays valid after the file is closed
+#endif
+        if (!base) {
+            length = 0;
+            close();
+            return false;
+        }
+        if (!validate()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //maps binPath, rebuilding it from csvPath first if it is missing, stale or
+    //from another layout. falls back to an in-memory image if the file cannot be written.
+    bool open(const char* csvPath, const char* binPath) {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool haveCsv = tableFingerprint(csvPath, size, mtime);
+
+        if (mapFile(binPath)) {
+            if (!haveCsv || (header()->sourceSize == size && header()->sourceMtime == mtime)) return true;
+            close();
+        }
+        if (!haveCsv) return false;
+        if (buildDrinkSnapshot(csvPath, binPath) && mapFile(binPath)) return true;
+
+        std::vector<DrinkRecord> records;
+        if (!readDrinkCsv(csvPath, records)) return false;
+        buildSnapshotImage(records, size, mtime, owned);
+        base = &owned[0];
+        length = owned.size();
+        return true;
+    }
+
+    //holds an image of records built in memory, e.g. a menu published live (live_catalog.h)
+    void assign(const std::vector<DrinkRecord>& records) {
+        close();
+        buildSnapshotImage(records, 0, 0, owned);
+        base = &owned[0];
+        length = owned.size();
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    int count() const { return base ? (int)header()->recordCount : 0; }
+
+    const DrinkRecord* records() const {
+        return (const DrinkRecord*)(base + header()->recordsOffset);
+    }
+
+    const DrinkRecord& at(int slot) const { return records()[slot]; }
+
+    //O(1) lookup through the stored id table, -1 if not found
+    int findSlot(int id) const {
+        if (!base) return -1;
+        const int32_t* table = (const int32_t*)(base + header()->idTableOffset);
+        unsigned mask = (unsigned)header()->idTableSize - 1;
+        unsigned pos = snapshotHashId(id) & mask;
+        while (table[pos] != -1) {
+            if (records()[table[pos]].id == id) return table[pos];
+            pos = (pos + 1) & mask;
+        }
+        return -1;
+    }
+
+    int categoryCount() const { return base ? (int)header()->categoryCount : 0; }
+
+    const SnapshotCategory& category(int c) const {
+        return ((const SnapshotCategory*)(base + header()->categoriesOffset))[c];
+    }
+
+    //slots of category c, in record order
+    const uint32_t* categorySlots(int c) const {
+        return (const uint32_t*)(base + header()->categorySlotsOffset) + category(c).first;
+    }
+};
+
+#endif
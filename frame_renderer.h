@@ -0,0 +1,196 @@
+#ifndef FRAME_RENDERER_H
+#define FRAME_RENDERER_H
+
+//buffered terminal screens: each screen is built into one string and written in a
+//single call using ANSI escapes, instead of system("cls") plus a write per row.
+//when the same screen is drawn again only the lines that changed are rewritten.
+
+#include <cstdio>
+#include <cstdarg>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class FrameRenderer {
+private:
+    std::string buf;
+    std::vector<std::string> shown;  //lines on the terminal from the last flush
+    int shownScreen;
+    int screen;
+    bool needClear;
+
+    static void writeOut(const std::string& out) {
+        fflush(stdout);
+#ifdef _WIN32
+        DWORD written;
+        WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), out.data(), (DWORD)out.size(), &written, NULL);
+#else
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+#endif
+    }
+
+    static void moveTo(std::string& out, int row) {
+        char seq[24];
+        snprintf(seq, sizeof(seq), "\x1b[%d;1H", row);
+        out += seq;
+    }
+
+public:
+    FrameRenderer() : shownScreen(-1), screen(-1), needClear(true) {
+#ifdef _WIN32
+        //escape sequences need virtual terminal processing on the windows console
+        HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        if (GetConsoleMode(h, &mode)) SetConsoleMode(h, mode | 0x0004);
+#endif
+    }
+
+    //starts a new frame; frames with the same screen id are diffed against each other
+    void begin(int screenId) {
+        buf.clear();
+        screen = screenId;
+    }
+
+    void add(const std::string& text) {
+        buf += text;
+    }
+
+    void addf(const char* fmt, ...) {
+        char small[512];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(small, sizeof(small), fmt, args);
+        va_end(args);
+        if (n < 0) return;
+        if (n < (int)sizeof(small)) {
+            buf.append(small, n);
+            return;
+        }
+        std::string big(n + 1, '\0');
+        va_start(args, fmt);
+        vsnprintf(&big[0], big.size(), fmt, args);
+        va_end(args);
+        buf.append(big.data(), n);
+    }
+
+    //writes the frame; a trailing line without '\n' is treated as the input prompt
+    void flush() {
+        std::vector<std::string> lines;
+        size_t start = 0;
+        while (start < buf.size()) {
+            size_t nl = buf.find('\n', start);
+            if (nl == std::string::npos) nl = buf.size();
+            lines.push_back(buf.substr(start, nl - start));
+            start = nl + 1;
+        }
+        bool hasPrompt = !buf.empty() && buf[buf.size() - 1] != '\n';
+
+        std::string out;
+        if (needClear || screen != shownScreen) {
+            out = "\x1b[H\x1b[2J";
+            out += buf;
+        } else {
+            for (size_t i = 0; i < lines.size(); i++) {
+                bool prompt = hasPrompt && i + 1 == lines.size();
+                if (prompt || i >= shown.size() || shown[i] != lines[i]) {
+                    moveTo(out, (int)i + 1);
+                    out += lines[i];
+                    out += "\x1b[K";
+                }
+            }
+            if (!hasPrompt) moveTo(out, (int)lines.size() + 1);
+            //drop whatever was typed or printed below the previous frame
+            out += "\x1b[J";
+        }
+        writeOut(out);
+
+        shown.swap(lines);
+        shownScreen = screen;
+        needClear = false;
+        buf.clear();
+    }
+
+    //blanks the terminal in one write; the next frame is drawn in full
+    void clear() {
+        writeOut("\x1b[H\x1b[2J");
+        invalidate();
+    }
+
+    void invalidate() {
+        needClear = true;
+        shown.clear();
+    }
+};
+
+//preformatted table rows, kept until the data version changes
+class RowCache {
+private:
+    std::vector<std::string> rows;
+    std::vector<char> ready;
+    unsigned long version;
+    bool synced;
+
+public:
+    RowCache() : version(0), synced(false) {}
+
+    void sync(unsigned long dataVersion, int count) {
+        if (!synced || dataVersion != version || (int)rows.size() != count) {
+            rows.assign(count, std::string());
+            ready.assign(count, 0);
+            version = dataVersion;
+            synced = true;
+        }
+    }
+
+    //row i, formatted by build(i, out) the first time it is needed
+    template <typename F>
+    const std::string& get(int i, F build) {
+        if (!ready[i]) {
+            rows[i].clear();
+            build(i, rows[i]);
+            ready[i] = 1;
+        }
+        return rows[i];
+    }
+};
+
+//page position over a list; only the visible page is formatted
+struct Pager {
+    int page;
+    int pageSize;
+
+    Pager(int size = 12) : page(0), pageSize(size) {}
+
+    int pageCount(int total) const { return total == 0 ? 1 : (total + pageSize - 1) / pageSize; }
+
+    void clampTo(int total) {
+        if (page > pageCount(total) - 1) page = pageCount(total) - 1;
+        if (page < 0) page = 0;
+    }
+
+    int first(int total) {
+        clampTo(total);
+        return page * pageSize;
+    }
+
+    int last(int total) {
+        int end = first(total) + pageSize;
+        return end < total ? end : total;
+    }
+
+    bool next(int total) {
+        if (page + 1 >= pageCount(total)) return false;
+        page++;
+        return true;
+    }
+    bool prev() {
+        if (page == 0) return false;
+        page--;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef HISTORY_WRITER_H
+#define HISTORY_WRITER_H
+
+//background writer for the order log (order_log.h). callers queue records and
+//return at once; one thread keeps the log open and appends everything queued
+//since its last write as a single batch. the durability mode decides when the
+//data is forced to disk:
+//  none   - written to the OS only, survives the program crashing
+//  batch  - fsync after every batch, records queued together share one sync
+//  record - fsync after every record
+//after each batch the running sales totals (sales_aggregates.h) are caught up
+//from the log, and checkpointed to base.agg at most once a second. a batch that
+//cannot be written (disk full, I/O error) stays queued and is retried with
+//growing pauses; lastError() says why, and close() reports what was left
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "order_log.h"
+#include "sales_aggregates.h"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+enum HistorySync { HISTORY_SYNC_NONE, HISTORY_SYNC_BATCH, HISTORY_SYNC_RECORD };
+
+//MIXUE_HISTORY_SYNC=none|batch|record, batch if unset
+inline HistorySync historySyncFromEnv() {
+    const char* v = getenv("MIXUE_HISTORY_SYNC");
+    if (v && strcmp(v, "none") == 0) return HISTORY_SYNC_NONE;
+    if (v && strcmp(v, "record") == 0) return HISTORY_SYNC_RECORD;
+    return HISTORY_SYNC_BATCH;
+}
+
+class HistoryWriter {
+private:
+    OrderLog log;
+    SalesAggregates sales;
+    std::string salesPath;
+    std::chrono::steady_clock::time_point salesSaved;
+    bool opened;
+    HistorySync mode;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::vector<OrderLogRecord> queue;
+    uint64_t queued;    //records ever appended
+    uint64_t written;   //records handed to the OS (and synced, per mode)
+    uint64_t batches;
+    bool stopping;
+    bool failing;       //the last write failed, its records are being retried
+    std::string error;  //why, empty once a write succeeds again
+
+    static bool syncFile(FILE* f) {
+        if (fflush(f) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    //writes the front of batch; returns how many records made it, setting why
+    //when that is not all of them
+    size_t writeBatch(std::vector<OrderLogRecord>& batch, std::string& why) {
+        size_t done = 0;
+        if (mode == HISTORY_SYNC_RECORD) {
+            std::vector<OrderLogRecord> one(1);
+            for (; done < batch.size(); done++) {
+                one[0] = batch[done];
+                if (!log.append(one)) break;
+                //a failed sync leaves the record in the OS, so it is not written again
+                if (!syncFile(log.dataFile())) why = std::string("sync failed: ") + strerror(errno);
+            }
+        } else if (log.append(batch)) {
+            done = batch.size();
+            if (mode == HISTORY_SYNC_BATCH && !syncFile(log.dataFile())) {
+                why = std::string("sync failed: ") + strerror(errno);
+            }
+        }
+        if (done < batch.size()) why = std::string("write failed: ") + strerror(errno);
+        return done;
+    }
+
+    void writeLoop() {
+        std::vector<OrderLogRecord> batch;   //taken from the queue, not yet written
+        int backoffMs = 0;
+        bool lastTry = false;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (backoffMs) wake.wait_for(guard, std::chrono::milliseconds(backoffMs), [&] { return stopping; });
+                else wake.wait(guard, [&] { return stopping || !queue.empty(); });
+                if (batch.empty() && queue.empty()) break;
+                lastTry = stopping && backoffMs > 0;   //a failing writer gets one more go at close
+                batch.insert(batch.end(), queue.begin(), queue.end());
+                queue.clear();
+            }
+
+            std::string why;
+            size_t done = writeBatch(batch, why);
+            if (done) {
+                sales.catchUp(log);
+                if (std::chrono::steady_clock::now() - salesSaved >= std::chrono::seconds(1)) {
+                    sales.save(salesPath.c_str());
+                    salesSaved = std::chrono::steady_clock::now();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                written += done;
+                if (done) batches++;
+                failing = done < batch.size();
+                error = why;
+            }
+            drained.notify_all();
+            batch.erase(batch.begin(), batch.begin() + done);
+            if (batch.empty()) {
+                backoffMs = 0;
+            } else {
+                if (lastTry) break;
+                backoffMs = backoffMs ? (backoffMs < 5000 ? backoffMs * 2 : 5000) : 100;
+            }
+        }
+    }
+
+public:
+    HistoryWriter() : opened(false), mode(HISTORY_SYNC_BATCH), queued(0), written(0),
+                      batches(0), stopping(false), failing(false) {}
+
+    ~HistoryWriter() {
+        close();
+    }
+
+    //opens base.log for append (see OrderLog::open; a torn last record is
+    //written over by the next append), brings the sales checkpoint up to date,
+    //and starts the thread
+    bool open(const char* base, HistorySync syncMode) {
+        close();
+        if (!log.open(base, true)) return false;
+        salesPath = std::string(base) + ".agg";
+        sales.load(salesPath.c_str());
+        if (sales.catchUp(log) > 0) sales.save(salesPath.c_str());
+        salesSaved = std::chrono::steady_clock::now();
+        opened = true;
+        mode = syncMode;
+        stopping = false;
+        failing = false;
+        error.clear();
+        worker = std::thread(&HistoryWriter::writeLoop, this);
+        return true;
+    }
+
+    //queues one complete record; never touches the file on the caller's thread
+    void append(const OrderLogRecord& record) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!opened) return;
+            queue.push_back(record);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    //waits until everything appended so far has been written; false if it
+    //could not be, see lastError()
+    bool flush() {
+        std::unique_lock<std::mutex> guard(lock);
+        uint64_t target = queued;
+        drained.wait(guard, [&] { return written >= target || !opened || failing; });
+        return written >= target;
+    }
+
+    //writes out the queue, then stops the thread and closes the file; false if
+    //records were left unwritten, queueDepth() says how many
+    bool close() {
+        if (!worker.joinable()) return queued == written;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            opened = false;
+        }
+        drained.notify_all();
+        syncFile(log.dataFile());
+        sales.catchUp(log);
+        sales.save(salesPath.c_str());
+        log.close();
+        return queued == written;
+    }
+
+    size_t queueDepth() {
+        std::lock_guard<std::mutex> guard(lock);
+        return (size_t)(queued - written);
+    }
+
+    uint64_t recordsWritten() {
+        std::lock_guard<std::mutex> guard(lock);
+        return written;
+    }
+
+    uint64_t batchesWritten() {
+        std::lock_guard<std::mutex> guard(lock);
+        return batches;
+    }
+
+    //why the last write failed, empty if it did not
+    std::string lastError() {
+        std::lock_guard<std::mutex> guard(lock);
+        return error;
+    }
+
+    bool isOpen() const { return opened; }
+};
+
+#endif
@@ -0,0 +1,464 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+//stock shared by every kiosk on the machine. inventory.bin is mapped into each
+//process; a drink's on-hand and reserved counts live together in one 64-bit
+//word that is only changed with compare-and-swap, so reserving never takes a
+//lock and two kiosks can never sell the same cup. the mapping is the storage:
+//every change is in the file as soon as it is made, flush() pushes it to disk.
+//each kiosk also counts what it holds per drink, so holds left behind by a
+//crashed or abandoned kiosk can be given back. a kiosk registers under
+//inventory.bin.lock with its process id, and an id whose process is still
+//running is never taken over. the drink table is sized from the catalog when
+//the file is created; drinks that do not fit later are not stock checked.
+//this file, not mixue.txt, is what is on hand: the admin program maps it
+//too, shows and reports stock from it and sets its stock counts here.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <string>
+#include "table_journal.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const uint32_t INVENTORY_VERSION = 1;
+const uint32_t INVENTORY_MIN_SLOTS = 1024;   //drinks, power of two for probing
+const uint32_t INVENTORY_KIOSKS = 16;
+
+struct InventoryHeader {
+    char magic[8];
+    std::atomic<uint32_t> version;   //0 until the first process sets up the file
+    uint32_t slots;                  //drink slots, fixed when the file is created
+    uint32_t kiosks;
+    uint32_t pad;
+};
+
+struct InventoryKiosk {
+    std::atomic<int32_t> kioskId;    //0 = free
+    int32_t pid;                     //process holding the entry, 0 in files from before pids
+    std::atomic<int64_t> heartbeat;  //time() of the kiosk's last activity
+};
+
+struct InventorySlot {
+    std::atomic<int32_t> drinkId;        //0 = free
+    std::atomic<int32_t> catalogStock;   //stock column last applied from mixue.txt
+    std::atomic<uint64_t> counts;        //on hand (low 32 bits), reserved (high 32 bits)
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8, "inventory counts must be a plain 64-bit word");
+
+class Inventory {
+private:
+    char* base;
+    size_t length;
+    int kiosk;    //index into the kiosk table, -1 when closed
+    int kioskId;
+    uint32_t slotCount;
+    std::string path;
+    bool busy;    //the last open was refused because the kiosk id is running
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mapHandle;
+#endif
+
+    static uint64_t pack(int32_t onHand, int32_t reserved) {
+        return (uint32_t)onHand | ((uint64_t)(uint32_t)reserved << 32);
+    }
+    static int32_t onHandOf(uint64_t c) { return (int32_t)(uint32_t)c; }
+    static int32_t reservedOf(uint64_t c) { return (int32_t)(uint32_t)(c >> 32); }
+
+    size_t fileSize() const {
+        return sizeof(InventoryHeader) + INVENTORY_KIOSKS * sizeof(InventoryKiosk) +
+               slotCount * sizeof(InventorySlot) + slotCount * INVENTORY_KIOSKS * sizeof(std::atomic<int32_t>);
+    }
+
+    InventoryHeader* header() const { return (InventoryHeader*)base; }
+    InventoryKiosk* kioskTable() const { return (InventoryKiosk*)(base + sizeof(InventoryHeader)); }
+    InventorySlot* slots() const {
+        return (InventorySlot*)(base + sizeof(InventoryHeader) + INVENTORY_KIOSKS * sizeof(InventoryKiosk));
+    }
+    //units of slot s reserved by kiosk k
+    std::atomic<int32_t>& held(int s, int k) const {
+        std::atomic<int32_t>* h = (std::atomic<int32_t>*)(base + sizeof(InventoryHeader) +
+                                                        INVENTORY_KIOSKS * sizeof(InventoryKiosk) +
+                                                        slotCount * sizeof(InventorySlot));
+        return h[s * INVENTORY_KIOSKS + k];
+    }
+
+    //slot of a drink id by open addressing; claims a free slot if create is set
+    int findSlot(int drinkId, bool create) const {
+        if (!base || drinkId <= 0) return -1;
+        uint32_t mask = slotCount - 1;
+        uint32_t i = ((uint32_t)drinkId * 2654435761u) & mask;
+        for (uint32_t n = 0; n < slotCount; n++, i = (i + 1) & mask) {
+            int32_t id = slots()[i].drinkId.load(std::memory_order_acquire);
+            if (id == drinkId) return (int)i;
+            if (id == 0) {
+                if (!create) return -1;
+                int32_t expected = 0;
+                if (slots()[i].drinkId.compare_exchange_strong(expected, drinkId) || expected == drinkId) {
+                    return (int)i;
+                }
+            }
+        }
+        return -1;
+    }
+
+    //applies on-hand and reserved deltas; refuses if the result would be negative
+    //or, when checkAvailable is set, would leave fewer on hand than reserved
+    static bool update(InventorySlot& slot, int32_t onHandDelta, int32_t reservedDelta, bool checkAvailable) {
+        uint64_t c = slot.counts.load(std::memory_order_relaxed);
+        while (true) {
+            int32_t onHand = onHandOf(c) + onHandDelta;
+            int32_t reserved = reservedOf(c) + reservedDelta;
+            if (reserved < 0) reserved = 0;   //a hold already given back by reclaim
+            if (onHand < 0) return false;
+            if (checkAvailable && onHand < reserved) return false;
+            if (slot.counts.compare_exchange_weak(c, pack(onHand, reserved), std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+    }
+
+    //gives back everything kiosk k holds
+    void releaseKiosk(int k) {
+        for (uint32_t s = 0; s < slotCount; s++) {
+            int32_t h = held(s, k).exchange(0);
+            if (h > 0) update(slots()[s], 0, -h, false);
+        }
+    }
+
+    static int currentPid() {
+#ifdef _WIN32
+        return (int)GetCurrentProcessId();
+#else
+        return (int)getpid();
+#endif
+    }
+
+    static bool processAlive(int pid) {
+#ifdef _WIN32
+        HANDLE p = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+        if (!p) return false;
+        DWORD code = 0;
+        bool alive = GetExitCodeProcess(p, &code) && code == STILL_ACTIVE;
+        CloseHandle(p);
+        return alive;
+#else
+        return kill(pid, 0) == 0 || errno == EPERM;
+#endif
+    }
+
+    //a registered kiosk whose process is running and that has not gone past
+    //its lease; entries written without a pid go by the lease alone
+    bool live(const InventoryKiosk& e, int64_t now) const {
+        if (e.kioskId.load() == 0 || now - e.heartbeat.load() > leaseSeconds) return false;
+        return e.pid <= 0 || e.pid == currentPid() || processAlive(e.pid);
+    }
+
+    bool idRunning(int id, int64_t now) const {
+        for (uint32_t k = 0; k < INVENTORY_KIOSKS; k++) {
+            if (kioskTable()[k].kioskId.load() == id && live(kioskTable()[k], now)) return true;
+        }
+        return false;
+    }
+
+    //takes a free kiosk entry for kioskId; under the registration lock
+    bool claimEntry(int64_t now) {
+        for (uint32_t k = 0; k < INVENTORY_KIOSKS; k++) {
+            int32_t expected = 0;
+            if (kioskTable()[k].kioskId.compare_exchange_strong(expected, kioskId)) {
+                kiosk = (int)k;
+                kioskTable()[k].pid = currentPid();
+                releaseKiosk(kiosk);
+                kioskTable()[k].heartbeat.store(now);
+                return true;
+            }
+        }
+        kiosk = -1;
+        return false;
+    }
+
+    //drink slots of an existing file, 0 if there is none yet
+    static uint32_t slotsInFile(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (!f) return 0;
+        char raw[sizeof(InventoryHeader)];
+        uint32_t version = 0, slots = 0;
+        if (fread(raw, sizeof(raw), 1, f) == 1 && memcmp(raw, "MIXUINV1", 8) == 0) {
+            memcpy(&version, raw + 8, 4);
+            memcpy(&slots, raw + 12, 4);
+        }
+        fclose(f);
+        return version == INVENTORY_VERSION ? slots : 0;
+    }
+
+    bool mapFile(const char* path) {
+#ifdef _WIN32
+        fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+        //mapping more than the file holds grows it, zero filled
+        mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, 0, (DWORD)fileSize(), NULL);
+        base = mapHandle ? (char*)MapViewOfFile(mapHandle, FILE_MAP_ALL_ACCESS, 0, 0, fileSize()) : nullptr;
+#else
+        int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        //growing is idempotent, so kiosks starting together all see the same zeroed file
+        if (fstat(fd, &st) != 0 || ((size_t)st.st_size < fileSize() && ftruncate(fd, (off_t)fileSize()) != 0)) {
+            ::close(fd);
+            return false;
+        }
+        void* p = mmap(nullptr, fileSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);   //the mapping stays valid after the file is closed
+        base = (p == MAP_FAILED) ? nullptr : (char*)p;
+#endif
+        if (!base) return false;
+        length = fileSize();
+        return true;
+    }
+
+    //maps path, setting the file up if this is the first process to use it;
+    //under the registration lock
+    bool mapShared(int drinkCount) {
+        slotCount = slotsInFile(path.c_str());
+        if (slotCount == 0) {
+            slotCount = INVENTORY_MIN_SLOTS;
+            while (slotCount < (uint32_t)drinkCount * 2) slotCount *= 2;
+        }
+        if ((slotCount & (slotCount - 1)) != 0 || !mapFile(path.c_str())) {
+            close();
+            return false;
+        }
+
+        InventoryHeader* h = header();
+        uint32_t v = 0;
+        if (h->version.compare_exchange_strong(v, INVENTORY_VERSION)) {
+            memcpy(h->magic, "MIXUINV1", 8);
+            h->slots = slotCount;
+            h->kiosks = INVENTORY_KIOSKS;
+        } else if (v != INVENTORY_VERSION || h->slots != slotCount || h->kiosks != INVENTORY_KIOSKS) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+public:
+    int leaseSeconds;   //a kiosk silent this long loses its holds to the others
+
+    Inventory() : base(nullptr), length(0), kiosk(-1), kioskId(0), slotCount(INVENTORY_MIN_SLOTS), busy(false),
+                  leaseSeconds(1800) {
+#ifdef _WIN32
+        fileHandle = INVALID_HANDLE_VALUE;
+        mapHandle = NULL;
+#endif
+    }
+
+    ~Inventory() {
+        close();
+    }
+
+    //maps the shared file and registers this kiosk as id, or as the lowest id
+    //no running kiosk has when id is 0. a new file gets room for drinkCount
+    //drinks. holds this kiosk left behind last time, and holds of kiosks that
+    //have exited or gone past their lease, are given back. false if the file
+    //cannot be used, or (isBusy()) if id belongs to a kiosk that is running
+    bool open(const char* filePath, int id, int drinkCount) {
+        close();
+        busy = false;
+        path = filePath;
+        TableLock lock(path);   //one kiosk registers at a time
+        if (!mapShared(drinkCount)) return false;
+
+        int64_t now = (int64_t)time(0);
+        for (uint32_t k = 0; k < INVENTORY_KIOSKS; k++) {
+            InventoryKiosk& e = kioskTable()[k];
+            int32_t other = e.kioskId.load();
+            if (other != 0 && !live(e, now) && e.kioskId.compare_exchange_strong(other, 0)) {
+                releaseKiosk((int)k);
+            }
+        }
+
+        if (id == 0) {
+            id = 1;
+            while (idRunning(id, now)) id++;
+        } else if (idRunning(id, now)) {
+            busy = true;
+            close();
+            return false;
+        }
+        kioskId = id;
+        if (!claimEntry(now)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    //maps the shared file without registering as a kiosk, for the admin
+    //program: it reads and sets stock but never holds any
+    bool attach(const char* filePath, int drinkCount) {
+        close();
+        busy = false;
+        path = filePath;
+        TableLock lock(path);
+        return mapShared(drinkCount);
+    }
+
+    //gives back this kiosk's holds and unmaps the file
+    void close() {
+        if (base && kiosk != -1) {
+            releaseKiosk(kiosk);
+            int32_t id = kioskId;
+            kioskTable()[kiosk].kioskId.compare_exchange_strong(id, 0);
+        }
+        if (base) {
+            flush();
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+#else
+            munmap(base, length);
+#endif
+        }
+#ifdef _WIN32
+        if (mapHandle) CloseHandle(mapHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mapHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#endif
+        base = nullptr;
+        length = 0;
+        kiosk = -1;
+    }
+
+    //applies the stock column of the catalog: a drink seen for the first time
+    //starts with that stock, a changed value (mixue.txt edited by hand) adds
+    //the difference. the admin program records its own writes with setStock
+    //and noteCatalogStock, so they are not added again here. safe with several
+    //kiosks syncing at once
+    template <typename Record>
+    void sync(const Record* drinks, int count) {
+        for (int i = 0; i < count; i++) {
+            int s = findSlot(drinks[i].id, true);
+            if (s == -1) continue;
+            int32_t before = slots()[s].catalogStock.exchange(drinks[i].stock);
+            if (drinks[i].stock != before) update(slots()[s], drinks[i].stock - before, 0, false);
+        }
+    }
+
+    //holds qty units for this kiosk; false if fewer are available. a drink
+    //the table has no room for is not tracked and always succeeds
+    bool reserve(int drinkId, int qty) {
+        if (kiosk == -1 || qty < 0) return false;
+        int s = findSlot(drinkId, false);
+        if (s == -1 || qty == 0) return true;
+        if (!update(slots()[s], 0, qty, true)) return false;
+        held(s, kiosk).fetch_add(qty);
+        return true;
+    }
+
+    //gives back units held by this kiosk
+    void release(int drinkId, int qty) {
+        int s = findSlot(drinkId, false);
+        if (s == -1 || kiosk == -1 || qty <= 0) return;
+        held(s, kiosk).fetch_sub(qty);
+        update(slots()[s], 0, -qty, false);
+    }
+
+    //turns held units into a sale
+    void commit(int drinkId, int qty) {
+        int s = findSlot(drinkId, false);
+        if (s == -1 || kiosk == -1 || qty <= 0) return;
+        held(s, kiosk).fetch_sub(qty);
+        update(slots()[s], -qty, -qty, false);
+    }
+
+    //units that can still be reserved, -1 for a drink the inventory does not track
+    int available(int drinkId) const {
+        int s = findSlot(drinkId, false);
+        if (s == -1) return -1;
+        uint64_t c = slots()[s].counts.load(std::memory_order_acquire);
+        int n = onHandOf(c) - reservedOf(c);
+        return n > 0 ? n : 0;
+    }
+
+    //units on hand, held ones included; -1 for a drink the inventory does not track
+    int onHand(int drinkId) const {
+        int s = findSlot(drinkId, false);
+        if (s == -1) return -1;
+        return onHandOf(slots()[s].counts.load(std::memory_order_acquire));
+    }
+
+    //the admin's stock count: on hand becomes onHand, whatever the kiosks sold
+    //meanwhile, and the catalog column is taken as already applied. false if
+    //more than onHand are held in carts right now. a drink the table has no
+    //room for is not tracked and always succeeds
+    bool setStock(int drinkId, int32_t onHand) {
+        if (onHand < 0) return false;
+        int s = findSlot(drinkId, true);
+        if (s == -1) return true;
+        InventorySlot& slot = slots()[s];
+        uint64_t c = slot.counts.load(std::memory_order_relaxed);
+        do {
+            if (reservedOf(c) > onHand) return false;
+        } while (!slot.counts.compare_exchange_weak(c, pack(onHand, reservedOf(c)), std::memory_order_acq_rel));
+        slot.catalogStock.store(onHand);
+        return true;
+    }
+
+    //records value as the catalog's stock column without changing what is on
+    //hand, for a catalog write that does not change stock
+    void noteCatalogStock(int drinkId, int32_t value) {
+        int s = findSlot(drinkId, true);
+        if (s != -1) slots()[s].catalogStock.store(value);
+    }
+
+    //marks this kiosk as alive; false if its holds were reclaimed meanwhile,
+    //in which case it has registered again with nothing held
+    bool heartbeat() {
+        if (kiosk == -1) return false;
+        int64_t now = (int64_t)time(0);
+        InventoryKiosk& e = kioskTable()[kiosk];
+        if (e.kioskId.load() == kioskId && e.pid == currentPid()) {
+            e.heartbeat.store(now);
+            return true;
+        }
+        TableLock lock(path);
+        if (idRunning(kioskId, now)) {
+            kiosk = -1;   //another kiosk took the id meanwhile; stock is no longer checked here
+            return false;
+        }
+        claimEntry(now);
+        return false;
+    }
+
+    //asks the OS to write the mapped pages out, without waiting
+    void flush() {
+        if (!base) return;
+#ifdef _WIN32
+        FlushViewOfFile(base, length);
+#else
+        msync(base, length, MS_ASYNC);
+#endif
+    }
+
+    bool isOpen() const { return base != nullptr && kiosk != -1; }
+    bool isMapped() const { return base != nullptr; }
+    bool isBusy() const { return busy; }
+    int id() const { return kioskId; }
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef KEYSET_INDEX_H
+#define KEYSET_INDEX_H
+
+//ordered (key, id) index for keyset pagination. a page is found from the row
+//it starts after (or ends before), not from a row number, so the next page
+//costs a tree descent plus the page, however far into the list it is, and an
+//edit elsewhere in the list never shifts what the next page shows. the index
+//is kept in step with every put and erase instead of being rebuilt per view;
+//ties on the key are broken by id so every row has one place.
+
+#include <climits>
+#include <set>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+template <typename K>
+class KeysetIndex {
+private:
+    typedef std::pair<K, int> Entry;
+    std::set<Entry> entries;
+    std::unordered_map<int, K> keyOf;
+
+    //ids from it onwards, at most count
+    std::vector<int> forward(typename std::set<Entry>::const_iterator it, size_t count) const {
+        std::vector<int> ids;
+        for (; it != entries.end() && ids.size() < count; ++it) ids.push_back(it->second);
+        return ids;
+    }
+
+public:
+    //adds id, or moves it if its key changed
+    void put(int id, const K& key) {
+        erase(id);
+        entries.insert(Entry(key, id));
+        keyOf[id] = key;
+    }
+
+    void erase(int id) {
+        typename std::unordered_map<int, K>::iterator it = keyOf.find(id);
+        if (it == keyOf.end()) return;
+        entries.erase(Entry(it->second, id));
+        keyOf.erase(it);
+    }
+
+    void clear() {
+        entries.clear();
+        keyOf.clear();
+    }
+
+    bool has(int id) const { return keyOf.count(id) != 0; }
+    int size() const { return (int)entries.size(); }
+
+    //the first count ids in key order
+    std::vector<int> first(size_t count) const {
+        return forward(entries.begin(), count);
+    }
+
+    //the count ids that follow id; empty at the end of the list
+    std::vector<int> after(int id, size_t count) const {
+        typename std::unordered_map<int, K>::const_iterator k = keyOf.find(id);
+        if (k == keyOf.end()) return first(count);
+        return forward(entries.upper_bound(Entry(k->second, id)), count);
+    }
+
+    //the count ids that come before id, in key order; empty at the start
+    std::vector<int> before(int id, size_t count) const {
+        typename std::unordered_map<int, K>::const_iterator k = keyOf.find(id);
+        if (k == keyOf.end()) return first(count);
+        typename std::set<Entry>::const_iterator it = entries.lower_bound(Entry(k->second, id));
+        size_t back = 0;
+        while (it != entries.begin() && back < count) {
+            --it;
+            back++;
+        }
+        return forward(it, back);
+    }
+
+    //a page starting at id itself
+    std::vector<int> from(int id, size_t count) const {
+        typename std::unordered_map<int, K>::const_iterator k = keyOf.find(id);
+        if (k == keyOf.end()) return std::vector<int>();
+        return forward(entries.lower_bound(Entry(k->second, id)), count);
+    }
+
+    //a page starting at the first row whose key is not below key
+    std::vector<int> seek(const K& key, size_t count) const {
+        return forward(entries.lower_bound(Entry(key, INT_MIN)), count);
+    }
+};
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef KITCHEN_SCHEDULER_H
+#define KITCHEN_SCHEDULER_H
+
+//kitchen scheduling: prep time estimates per drink, a queue that picks the
+//next batch (shortest prep first with aging, identical drinks from different
+//orders made together, or plain FIFO for comparison), and a kitchen floor of
+//staffed stations driven by a clock. the same floor runs live behind the
+//dashboard and inside the deterministic simulation.
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include "order_id.h"
+
+//seconds to make one cup; ice and sweet are 1 regular, 2 less, 3 none
+inline double estimatePrepSeconds(const char* category, int ice, int sweet) {
+    double base = 75;
+    if (strstr(category, "Tea")) base = 60;            //brewed, poured over ice
+    else if (strstr(category, "Beverage")) base = 90;  //milk teas with toppings
+    else if (strstr(category, "Juice")) base = 100;    //blended
+    else if (strstr(category, "Ice Cream")) base = 45;
+    if (ice == 2) base += 5;       //measured instead of a full scoop
+    else if (ice == 3) base -= 5;
+    if (sweet == 2 || sweet == 3) base += 5;
+    return base;
+}
+
+//each extra identical cup in a batch costs this share of one cup
+const double KITCHEN_EXTRA_CUP = 0.35;
+
+struct KitchenItem {
+    OrderId order;
+    int drinkId;
+    uint8_t custom;       //packed ice/sweetness; batches need the same drink and custom
+    int quantity;
+    double unitSeconds;   //estimatePrepSeconds for one cup
+    double arrival;
+};
+
+struct KitchenBatch {
+    int drinkId;
+    uint8_t custom;
+    int quantity;
+    double prepSeconds;
+    std::vector<KitchenItem> items;
+};
+
+enum KitchenPolicy {
+    KITCHEN_FIFO,   //oldest item first, one item at a time
+    KITCHEN_SPF     //shortest batch first, aged by waiting time, identical drinks batched
+};
+
+inline double batchSeconds(double unitSeconds, int quantity) {
+    return unitSeconds * (1 + KITCHEN_EXTRA_CUP * (quantity - 1));
+}
+
+class KitchenScheduler {
+private:
+    std::vector<KitchenItem> pending;   //arrival order
+
+public:
+    KitchenPolicy policy;
+    double agingWeight;   //seconds of priority gained per second waited
+    int maxBatch;         //cups one station makes at once
+
+    KitchenScheduler(KitchenPolicy p = KITCHEN_SPF, double aging = 0.5, int batchLimit = 6)
+        : policy(p), agingWeight(aging), maxBatch(batchLimit) {}
+
+    void add(const KitchenItem& item) {
+        pending.push_back(item);
+    }
+
+    bool empty() const { return pending.empty(); }
+
+    int waitingCups() const {
+        int cups = 0;
+        for (size_t i = 0; i < pending.size(); i++) cups += pending[i].quantity;
+        return cups;
+    }
+
+    //takes the next batch off the queue at time now
+    bool nextBatch(double now, KitchenBatch& out) {
+        if (pending.empty()) return false;
+
+        size_t pick = 0;
+        if (policy == KITCHEN_SPF) {
+            //score every distinct drink/customization once, by its oldest item
+            double best = 0;
+            std::map<std::pair<int, int>, bool> seen;
+            for (size_t i = 0; i < pending.size(); i++) {
+                std::pair<int, int> key(pending[i].drinkId, pending[i].custom);
+                if (seen.count(key)) continue;
+                seen[key] = true;
+                int cups = 0;
+                for (size_t j = i; j < pending.size() && cups < maxBatch; j++) {
+                    if (pending[j].drinkId == key.first && pending[j].custom == key.second) {
+                        cups += pending[j].quantity;
+                    }
+                }
+                double score = batchSeconds(pending[i].unitSeconds, (std::min)(cups, maxBatch)) -
+                               agingWeight * (now - pending[i].arrival);
+                if (i == 0 || score < best) {
+                    best = score;
+                    pick = i;
+                }
+            }
+        }
+
+        const KitchenItem& head = pending[pick];
+        out.drinkId = head.drinkId;
+        out.custom = head.custom;
+        out.quantity = 0;
+        out.items.clear();
+        double unit = head.unitSeconds;
+
+        std::vector<KitchenItem> rest;
+        rest.reserve(pending.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            const KitchenItem& it = pending[i];
+            bool join = i == pick ||
+                        (policy == KITCHEN_SPF && i > pick && it.drinkId == out.drinkId &&
+                         it.custom == out.custom && out.quantity + it.quantity <= maxBatch);
+            if (join) {
+                out.items.push_back(it);
+                out.quantity += it.quantity;
+            } else {
+                rest.push_back(it);
+            }
+        }
+        pending.swap(rest);
+        out.prepSeconds = batchSeconds(unit, out.quantity);
+        return true;
+    }
+};
+
+//staffed stations working through a KitchenScheduler; time is in seconds on
+//whatever clock the caller uses, and only moves forward
+class KitchenFloor {
+private:
+    struct Station {
+        bool busy;
+        double freeAt;
+        KitchenBatch batch;
+    };
+    struct Progress {
+        double arrival;
+        int itemsLeft;
+    };
+
+    KitchenScheduler queue;
+    std::vector<Station> stations;
+    std::map<OrderId, Progress> open;
+    double clock;
+
+    void dispatch(double now) {
+        for (size_t s = 0; s < stations.size(); s++) {
+            if (stations[s].busy) continue;
+            if (!queue.nextBatch(now, stations[s].batch)) return;
+            stations[s].busy = true;
+            stations[s].freeAt = now + stations[s].batch.prepSeconds;
+        }
+    }
+
+public:
+    KitchenFloor(int staff, KitchenPolicy policy = KITCHEN_SPF, double aging = 0.5, int maxBatch = 6)
+        : queue(policy, aging, maxBatch), stations(staff > 0 ? staff : 1), clock(0) {
+        for (size_t s = 0; s < stations.size(); s++) {
+            stations[s].busy = false;
+            stations[s].freeAt = 0;
+        }
+    }
+
+    //queues an order that arrived at time arrival (not before the last advance)
+    void addOrder(OrderId id, double arrival, const std::vector<KitchenItem>& items) {
+        if (items.empty()) return;
+        Progress p;
+        p.arrival = arrival;
+        p.itemsLeft = (int)items.size();
+        open[id] = p;
+        for (size_t i = 0; i < items.size(); i++) {
+            KitchenItem it = items[i];
+            it.order = id;
+            it.arrival = arrival;
+            queue.add(it);
+        }
+        if (arrival > clock) clock = arrival;
+        dispatch(clock);
+    }
+
+    //runs the kitchen up to time now; ready(orderId, waitSeconds, readyAt) is
+    //called for every order whose last drink is finished
+    template <typename F>
+    void advance(double now, F ready) {
+        while (true) {
+            int next = -1;
+            for (size_t s = 0; s < stations.size(); s++) {
+                if (stations[s].busy && stations[s].freeAt <= now &&
+                    (next == -1 || stations[s].freeAt < stations[next].freeAt)) {
+                    next = (int)s;
+                }
+            }
+            if (next == -1) break;
+
+            Station& st = stations[next];
+            double t = st.freeAt;
+            st.busy = false;
+            for (size_t i = 0; i < st.batch.items.size(); i++) {
+                std::map<OrderId, Progress>::iterator it = open.find(st.batch.items[i].order);
+                if (it == open.end()) continue;
+                if (--it->second.itemsLeft == 0) {
+                    ready(it->first, t - it->second.arrival, t);
+                    open.erase(it);
+                }
+            }
+            clock = t;
+            dispatch(t);
+        }
+        if (now > clock) clock = now;
+    }
+
+    int staff() const { return (int)stations.size(); }
+    int openOrders() const { return (int)open.size(); }
+    int waitingCups() const { return queue.waitingCups(); }
+
+    //batch at a station, null when it is idle
+    const KitchenBatch* preparing(int station) const {
+        return stations[station].busy ? &stations[station].batch : nullptr;
+    }
+};
+
+struct KitchenSimOrder {
+    OrderId id;
+    double arrival;
+    std::vector<KitchenItem> items;
+};
+
+struct KitchenSimReport {
+    int orders;
+    int cups;
+    double makespan;       //first arrival to last order ready
+    double cupsPerHour;
+    double meanWait;
+    double p50Wait;
+    double p99Wait;
+};
+
+//replays orders (sorted by arrival) through a fresh floor; fully deterministic
+inline KitchenSimReport simulateKitchen(const std::vector<KitchenSimOrder>& orders, int staff,
+                                        KitchenPolicy policy, double aging = 0.5, int maxBatch = 6) {
+    KitchenFloor floor(staff, policy, aging, maxBatch);
+    std::vector<double> waits;
+    double lastReady = 0;
+    KitchenSimReport r;
+    r.orders = (int)orders.size();
+    r.cups = 0;
+
+    for (size_t i = 0; i < orders.size(); i++) {
+        floor.advance(orders[i].arrival, [&](OrderId, double wait, double at) {
+            waits.push_back(wait);
+            if (at > lastReady) lastReady = at;
+        });
+        floor.addOrder(orders[i].id, orders[i].arrival, orders[i].items);
+        for (size_t j = 0; j < orders[i].items.size(); j++) r.cups += orders[i].items[j].quantity;
+    }
+    floor.advance(1e18, [&](OrderId, double wait, double at) {
+        waits.push_back(wait);
+        if (at > lastReady) lastReady = at;
+    });
+
+    std::sort(waits.begin(), waits.end());
+    double sum = 0;
+    for (size_t i = 0; i < waits.size(); i++) sum += waits[i];
+    double first = orders.empty() ? 0 : orders[0].arrival;
+    r.makespan = orders.empty() ? 0 : lastReady - first;
+    r.cupsPerHour = r.makespan > 0 ? r.cups * 3600.0 / r.makespan : 0;
+    r.meanWait = waits.empty() ? 0 : sum / waits.size();
+    //nearest rank
+    r.p50Wait = waits.empty() ? 0 : waits[(size_t)((waits.size() - 1) * 0.50 + 0.5)];
+    r.p99Wait = waits.empty() ? 0 : waits[(size_t)((waits.size() - 1) * 0.99 + 0.5)];
+    return r;
+}
+
+//MIXUE_KITCHEN_STAFF from the environment, 2 if unset or invalid
+inline int kitchenStaffFromEnv() {
+    const char* v = getenv("MIXUE_KITCHEN_STAFF");
+    int n = v ? atoi(v) : 0;
+    return (n > 0 && n <= 32) ? n : 2;
+}
+
+//seconds on a monotonic clock, for running a KitchenFloor live
+inline double kitchenNow() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
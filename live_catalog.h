@@ -0,0 +1,220 @@
+#ifndef LIVE_CATALOG_H
+#define LIVE_CATALOG_H
+
+//the drink menu as last published by the admin program, in a file mapped by
+//every process on the machine (mixue.live), so menu and price changes reach
+//running kiosks without a restart. the region is guarded by a seqlock: the
+//publisher makes the sequence odd, copies the records in, then makes it even
+//again; a reader copies the records out and keeps the copy only if it saw the
+//same even sequence before and after. readers take no lock and never wait on
+//a publisher, they just retry. publishers are serialized by a file lock, and
+//one that finds the sequence left odd by a crashed publisher carries on from
+//it. a kiosk polls sequence() before drawing a menu; it is one atomic load.
+//the region holds as many drinks as the header's slot count. a publisher with
+//a bigger menu doubles it under the lock, grows the file and remaps before it
+//starts copying; a reader that sees more drinks than its mapping holds remaps
+//to the new slot count and retries. the file never shrinks.
+//only stdio and the mapping calls are used, both programs include this.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include "drink_snapshot.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <sys/mman.h>
+#endif
+
+const uint32_t LIVE_CATALOG_VERSION = 1;
+const uint32_t LIVE_CATALOG_MIN_SLOTS = 1024;   //drinks in a new file, the size older files have
+
+struct LiveCatalogHeader {
+    char magic[8];                     //"MIXULIVE"
+    std::atomic<uint32_t> version;     //0 until the first process sets up the file
+    uint32_t recordSize;
+    std::atomic<uint64_t> sequence;    //odd while a publish is in progress, 0 = never published
+    uint32_t count;                    //records in use, written under the seqlock
+    std::atomic<uint32_t> slots;       //records the file holds, only grows; 0 in older files
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == 8, "the sequence must be a plain 64-bit word");
+
+class LiveCatalog {
+private:
+    char* base;
+    FILE* file;         //kept open for the publisher's lock
+    uint32_t mapped;    //slots the current mapping holds
+#ifdef _WIN32
+    HANDLE mapHandle;
+#endif
+
+    static size_t regionSize(uint32_t slots) {
+        return sizeof(LiveCatalogHeader) + (size_t)slots * sizeof(DrinkRecord);
+    }
+
+    void unmap() {
+        if (base) {
+#ifdef _WIN32
+            UnmapViewOfFile(base);
+#else
+            munmap(base, regionSize(mapped));
+#endif
+        }
+#ifdef _WIN32
+        if (mapHandle) CloseHandle(mapHandle);
+        mapHandle = NULL;
+#endif
+        base = nullptr;
+        mapped = 0;
+    }
+
+    //maps the first slots records, growing the file if it is shorter
+    bool map(uint32_t slots) {
+        unmap();
+        //writing the last byte grows the file with zeros; every process writes the same
+        fseek(file, 0, SEEK_END);
+        if ((size_t)ftell(file) < regionSize(slots)) {
+            fseek(file, (long)regionSize(slots) - 1, SEEK_SET);
+            fputc(0, file);
+            fflush(file);
+        }
+#ifdef _WIN32
+        mapHandle = CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(file)), NULL, PAGE_READWRITE, 0,
+                                       (DWORD)regionSize(slots), NULL);
+        base = mapHandle ? (char*)MapViewOfFile(mapHandle, FILE_MAP_ALL_ACCESS, 0, 0, regionSize(slots)) : nullptr;
+#else
+        void* p = mmap(nullptr, regionSize(slots), PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+        base = (p == MAP_FAILED) ? nullptr : (char*)p;
+#endif
+        if (base) mapped = slots;
+        return base != nullptr;
+    }
+
+    //slots the file holds now, at least the minimum
+    uint32_t fileSlots() const {
+        uint32_t n = header()->slots.load(std::memory_order_acquire);
+        return n < LIVE_CATALOG_MIN_SLOTS ? LIVE_CATALOG_MIN_SLOTS : n;
+    }
+
+    LiveCatalogHeader* header() const { return (LiveCatalogHeader*)base; }
+    DrinkRecord* records() const { return (DrinkRecord*)(base + sizeof(LiveCatalogHeader)); }
+
+    void lock(bool on) {
+#ifdef _WIN32
+        HANDLE h = (HANDLE)_get_osfhandle(_fileno(file));
+        OVERLAPPED ov = {0};
+        if (on) LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+        else UnlockFileEx(h, 0, 1, 0, &ov);
+#else
+        flock(fileno(file), on ? LOCK_EX : LOCK_UN);
+#endif
+    }
+
+public:
+    LiveCatalog() : base(nullptr), file(nullptr), mapped(0) {
+#ifdef _WIN32
+        mapHandle = NULL;
+#endif
+    }
+
+    ~LiveCatalog() {
+        close();
+    }
+
+    //maps path, creating it zero filled (never published) if needed
+    bool open(const char* path) {
+        close();
+        file = fopen(path, "r+b");
+        if (!file) file = fopen(path, "w+b");
+        if (!file || !map(LIVE_CATALOG_MIN_SLOTS) || (fileSlots() > mapped && !map(fileSlots()))) {
+            close();
+            return false;
+        }
+
+        LiveCatalogHeader* h = header();
+        uint32_t v = 0;
+        if (h->version.compare_exchange_strong(v, LIVE_CATALOG_VERSION)) {
+            memcpy(h->magic, "MIXULIVE", 8);
+            h->recordSize = sizeof(DrinkRecord);
+        } else if (v != LIVE_CATALOG_VERSION || h->recordSize != sizeof(DrinkRecord)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        unmap();
+        if (file) fclose(file);
+        file = nullptr;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    //changes whenever a publish starts or ends; 0 if never published
+    uint64_t sequence() const {
+        return base ? header()->sequence.load(std::memory_order_acquire) : 0;
+    }
+
+    //replaces the published menu, growing the file first if it does not fit;
+    //false if the file cannot be grown or remapped
+    bool publish(const DrinkRecord* drinks, int count) {
+        if (!base || count < 0) return false;
+        lock(true);
+        uint32_t slots = fileSlots();
+        while (slots < (uint32_t)count) slots *= 2;
+        if (slots > mapped && !map(slots)) {
+            lock(false);
+            return false;
+        }
+        //the file is grown before the slot count says so, which readers remap to
+        if (slots > header()->slots.load(std::memory_order_relaxed)) {
+            header()->slots.store(slots, std::memory_order_release);
+        }
+        LiveCatalogHeader* h = header();
+        uint64_t s = h->sequence.load(std::memory_order_relaxed);
+        if (s & 1) s++;   //a publisher died mid-copy; this copy replaces its half
+        h->sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        h->count = (uint32_t)count;
+        if (count) memcpy(records(), drinks, count * sizeof(DrinkRecord));
+        h->sequence.store(s + 2, std::memory_order_release);
+        lock(false);
+        return true;
+    }
+
+    //copies out a consistent menu and the sequence it was published under,
+    //remapping if the publisher grew the file; false if nothing was ever
+    //published, a publish kept getting in the way or the remap failed
+    bool read(std::vector<DrinkRecord>& out, uint64_t& seq) {
+        if (!base) return false;
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            if (fileSlots() > mapped && !map(fileSlots())) return false;
+            const LiveCatalogHeader* h = header();
+            uint64_t before = h->sequence.load(std::memory_order_acquire);
+            if (before == 0) return false;
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t count = h->count;
+            if (count > mapped) continue;   //a torn read, or the file grew: remapped next pass
+            out.resize(count);
+            if (count) memcpy(&out[0], records(), count * sizeof(DrinkRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (h->sequence.load(std::memory_order_relaxed) == before) {
+                seq = before;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+//money as whole cents in a 64-bit integer, so sums are exact and every
+//screen, receipt and file rounds the same way
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+typedef int64_t Cents;
+
+//"12", "12.5", "12.50" -> 1250; a third decimal rounds half up
+inline bool parseCents(const char* s, Cents& cents) {
+    int64_t whole = 0;
+    int frac = 0, digits = 0;
+    const char* p = s;
+    while (*p == ' ') p++;
+    if (*p < '0' || *p > '9') return false;
+    while (*p >= '0' && *p <= '9') {
+        if (whole > (INT64_MAX - 9) / 1000) return false;
+        whole = whole * 10 + (*p++ - '0');
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (digits < 2) frac = frac * 10 + (*p - '0');
+            else if (digits == 2 && *p >= '5') frac++;
+            digits++;
+            p++;
+        }
+    }
+    if (digits == 1) frac *= 10;
+    while (*p == ' ' || *p == '\r') p++;
+    if (*p != '\0') return false;
+    cents = whole * 100 + frac;
+    return true;
+}
+
+//1250 -> "12.50"; with trim, whole amounts drop the decimals ("12")
+inline std::string formatCents(Cents cents, bool trim = false) {
+    char buf[32];
+    bool negative = cents < 0;
+    uint64_t v = negative ? (uint64_t)0 - (uint64_t)cents : (uint64_t)cents;
+    if (trim && v % 100 == 0) {
+        snprintf(buf, sizeof(buf), "%s%llu", negative ? "-" : "",
+                 (unsigned long long)(v / 100));
+    } else {
+        snprintf(buf, sizeof(buf), "%s%llu.%02u", negative ? "-" : "",
+                 (unsigned long long)(v / 100), (unsigned)(v % 100));
+    }
+    return buf;
+}
+
+//batch pricing kernel: lineTotals[i] = price[i] * qty[i], returns the sum.
+//columns in, one branch-free loop with 64-bit products, so the compiler can
+//vectorize it and the total is the same however many lines are summed
+inline Cents extendLines(const int32_t* price, const int32_t* qty, Cents* lineTotals, size_t n) {
+    Cents total = 0;
+    for (size_t i = 0; i < n; i++) {
+        Cents line = (Cents)price[i] * qty[i];
+        lineTotals[i] = line;
+        total += line;
+    }
+    return total;
+}
+
+//same pass when only the sum is needed
+inline Cents sumLines(const int32_t* price, const int32_t* qty, size_t n) {
+    Cents total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += (Cents)price[i] * qty[i];
+    }
+    return total;
+}
+
+//price and quantity columns gathered from a cart or catalog for one kernel pass
+class PriceBatch {
+private:
+    std::vector<int32_t> prices;
+    std::vector<int32_t> quantities;
+    std::vector<Cents> lines;
+
+public:
+    void clear() {
+        prices.clear();
+        quantities.clear();
+        lines.clear();
+    }
+
+    void reserve(size_t n) {
+        prices.reserve(n);
+        quantities.reserve(n);
+    }
+
+    void add(int32_t priceCents, int32_t qty) {
+        prices.push_back(priceCents);
+        quantities.push_back(qty);
+    }
+
+    size_t size() const { return prices.size(); }
+
+    //prices every line; lineTotal(i) is valid afterwards
+    Cents run() {
+        lines.resize(prices.size());
+        if (prices.empty()) return 0;
+        return extendLines(prices.data(), quantities.data(), lines.data(), prices.size());
+    }
+
+    Cents total() const {
+        return prices.empty() ? 0 : sumLines(prices.data(), quantities.data(), prices.size());
+    }
+
+    Cents lineTotal(size_t i) const { return lines[i]; }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef ORDER_ID_H
+#define ORDER_ID_H
+
+//order ids without scanning the history: id = kioskId * 10^10 + sequence.
+//the sequence lives in a small shared file; each process locks it, reserves a
+//block of ids, writes the new high-water mark and syncs it before using any id
+//from the block, so a crash can only skip ids, never issue one twice.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#endif
+
+typedef int64_t OrderId;
+
+const OrderId ORDER_SEQ_RANGE = 10000000000LL;  //sequences per kiosk
+
+//under an exclusive lock on the sequence file at path: reads the high-water
+//mark (raised to at least floor), stores it + count and syncs it. returns the
+//first of the count reserved values, -1 if the file cannot be updated
+inline int64_t reserveSequence(const std::string& path, int64_t count, int64_t floor = 1) {
+    char buf[32] = {0};
+    int64_t start = 0;
+#ifdef _WIN32
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return -1;
+    OVERLAPPED ov = {0};
+    if (!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {
+        CloseHandle(h);
+        return -1;
+    }
+    DWORD got = 0;
+    ReadFile(h, buf, sizeof(buf) - 1, &got, NULL);
+    start = atoll(buf);
+    if (start < floor) start = floor;
+    int len = snprintf(buf, sizeof(buf), "%020lld\n", (long long)(start + count));
+    DWORD put = 0;
+    SetFilePointer(h, 0, NULL, FILE_BEGIN);
+    bool ok = WriteFile(h, buf, (DWORD)len, &put, NULL) && put == (DWORD)len &&
+              FlushFileBuffers(h);
+    UnlockFileEx(h, 0, 1, 0, &ov);
+    CloseHandle(h);
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return -1;
+    if (flock(fd, LOCK_EX) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    ssize_t got = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (got > 0) start = atoll(buf);
+    if (start < floor) start = floor;
+    int len = snprintf(buf, sizeof(buf), "%020lld\n", (long long)(start + count));
+    bool ok = pwrite(fd, buf, len, 0) == len && fsync(fd) == 0;
+    flock(fd, LOCK_UN);
+    ::close(fd);
+#endif
+    return ok ? start : -1;
+}
+
+class OrderIdAllocator {
+private:
+    std::string path;
+    int kiosk;
+    int blockSize;
+    OrderId nextSeq;    //next id in the reserved block
+    OrderId blockEnd;   //one past the block
+
+    bool reserveBlock() {
+        OrderId start = reserveSequence(path, blockSize);
+        if (start < 0 || start + blockSize >= ORDER_SEQ_RANGE) return false;
+        nextSeq = start;
+        blockEnd = start + blockSize;
+        return true;
+    }
+
+public:
+    OrderIdAllocator() : kiosk(1), blockSize(32), nextSeq(0), blockEnd(0) {}
+
+    //seqPath is shared by every process that allocates ids; kioskId keeps
+    //kiosks with separate files apart
+    void open(const char* seqPath, int kioskId, int block = 32) {
+        path = seqPath;
+        kiosk = kioskId;
+        blockSize = block > 0 ? block : 1;
+        nextSeq = blockEnd = 0;
+    }
+
+    //O(1) except once per block; -1 if the sequence file cannot be updated
+    OrderId next() {
+        if (nextSeq >= blockEnd && !reserveBlock()) return -1;
+        return (OrderId)kiosk * ORDER_SEQ_RANGE + nextSeq++;
+    }
+
+    int kioskId() const { return kiosk; }
+};
+
+//MIXUE_KIOSK_ID from the environment, fallback if unset or invalid
+inline int kioskIdFromEnv(int fallback = 1) {
+    const char* v = getenv("MIXUE_KIOSK_ID");
+    int id = v ? atoi(v) : 0;
+    return (id > 0 && id < 900000000) ? id : fallback;
+}
+
+#endif
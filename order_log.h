@@ -0,0 +1,791 @@
+#ifndef ORDER_LOG_H
+#define ORDER_LOG_H
+
+//order history as a binary log with side indexes, replacing order_history.txt.
+//  order_history.log   - "ORDERLOG" header, then records: a fixed 56-byte header
+//                        and a length-prefixed item section. each record also
+//                        points back to the same customer's previous record
+//  order_history.oidx  - order id -> offset, a hash table on disk
+//  order_history.cidx  - customer id -> offset of their newest record, the same
+//opening reads only the index headers, so finding an order is a probe of the
+//table and one seek, and a customer's orders are a walk down their chain.
+//index files are only written under the log's lock, in log order, so a
+//customer's .cidx entry is always their newest record. the log is the truth:
+//each index file records how much of it the table covers, records past that
+//(appended by another kiosk, or left out by a crash) are indexed in memory
+//when seen and written to the tables by the next writer to take the lock. an
+//existing order_history.txt is imported on first open.
+//only stdio is used, both programs include this; syncing to disk is up to the
+//writer (history_writer.h).
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include "money.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+const uint32_t ORDER_LOG_VERSION = 1;
+const uint32_t ORDER_INDEX_VERSION = 2;
+const uint32_t ORDER_INDEX_MIN_BITS = 10;      //a new table has 1 << this entries
+const uint32_t ORDER_RECORD_MAGIC = 0x5244524F;  //"ORDR"
+
+struct OrderLogItem {
+    int32_t drinkId;      //0 for items imported from text
+    int quantity;
+    int ice;              //1 regular, 2 less, 3 none
+    int sweet;
+    Cents lineCents;
+    std::string name;
+};
+
+struct OrderLogRecord {
+    int64_t orderId;
+    int customerId;
+    time_t placed;
+    Cents total;
+    int itemCount;
+    std::vector<OrderLogItem> items;
+    int64_t offset;       //where it is in the log, set when read or appended
+    int64_t prev;         //the customer's previous record, -1 if none; set when read
+};
+
+struct OrderLogFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pad;
+};
+
+struct OrderRecordHeader {
+    uint32_t magic;
+    uint32_t itemsLength;       //bytes of item section that follow
+    int64_t orderId;
+    int64_t placed;
+    int64_t totalCents;
+    int64_t prevForCustomer;    //offset of the customer's previous record, -1 if none
+    int32_t customerId;
+    int32_t itemCount;
+    uint32_t check;             //FNV-1a over the fields above and the item section
+    uint32_t pad;
+};
+
+struct OrderIndexEntry {
+    int64_t key;
+    int64_t offset;             //0 = free
+};
+
+struct OrderIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotBits;          //the live table has 1 << slotBits entries
+    int64_t tableStart;         //where the live table is in the file
+    int64_t count;              //keys in it
+    int64_t covered;            //every log record before this offset is in the table
+    int64_t lastRecord;         //the last of those records, -1 if none
+};
+
+//FNV-1a over a record header (up to check) and its item section
+inline uint32_t orderRecordCheck(const OrderRecordHeader& h, const char* items, size_t length) {
+    const unsigned char* p = (const unsigned char*)&h;
+    uint32_t c = 2166136261u;
+    for (size_t i = 0; i < offsetof(OrderRecordHeader, check); i++) c = (c ^ p[i]) * 16777619u;
+    for (size_t i = 0; i < length; i++) c = (c ^ (unsigned char)items[i]) * 16777619u;
+    return c;
+}
+
+//one item in the item section: this, then nameLength bytes of name
+struct OrderItemHeader {
+    int32_t drinkId;
+    uint16_t quantity;
+    uint8_t ice;
+    uint8_t sweet;
+    int64_t lineCents;
+    uint8_t nameLength;
+    uint8_t pad[7];
+};
+
+//"MangoMojito (2) - Regular ice, Less sweet - RM 24.00", the text format's item
+inline std::string orderItemText(const OrderLogItem& item) {
+    static const char* levels[] = {"Regular", "Less", "None"};
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s (%d) - %s ice, %s sweet - RM %s", item.name.c_str(), item.quantity,
+             levels[(item.ice >= 1 && item.ice <= 3) ? item.ice - 1 : 0],
+             levels[(item.sweet >= 1 && item.sweet <= 3) ? item.sweet - 1 : 0],
+             formatCents(item.lineCents).c_str());
+    return buf;
+}
+
+//items joined by ", " as in order_history.txt; the reverse of orderItemText
+inline void parseOrderItems(const std::string& text, std::vector<OrderLogItem>& out) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t open = text.find(" (", pos);
+        size_t close = text.find(") - ", open);
+        size_t ice = text.find(" ice, ", close);
+        size_t sweet = text.find(" sweet - RM ", ice);
+        if (open == std::string::npos || close == std::string::npos || ice == std::string::npos ||
+            sweet == std::string::npos) {
+            break;
+        }
+        size_t next = text.find(", ", sweet);
+        size_t amountEnd = next == std::string::npos ? text.size() : next;
+
+        OrderLogItem item;
+        item.drinkId = 0;
+        item.name = text.substr(pos, open - pos);
+        item.quantity = atoi(text.c_str() + open + 2);
+        std::string iceName = text.substr(close + 4, ice - close - 4);
+        std::string sweetName = text.substr(ice + 6, sweet - ice - 6);
+        item.ice = iceName == "Less" ? 2 : iceName == "None" ? 3 : 1;
+        item.sweet = sweetName == "Less" ? 2 : sweetName == "None" ? 3 : 1;
+        item.lineCents = 0;
+        parseCents(text.substr(sweet + 12, amountEnd - sweet - 12).c_str(), item.lineCents);
+        if (item.quantity > 0) out.push_back(item);
+        pos = next == std::string::npos ? text.size() : next + 2;
+    }
+}
+
+class OrderLog {
+private:
+    std::string logPath, orderIndexPath, customerIndexPath;
+    FILE* data;
+    bool writable;
+    int64_t end;            //end of the last valid record
+    int64_t fileEnd;        //size of the log when last looked at
+    //records past what the index files covered when last looked at
+    std::unordered_map<int64_t, int64_t> byOrder;
+    std::unordered_map<int, int64_t> lastByCustomer;
+
+    static uint32_t checksum(const OrderRecordHeader& h, const std::string& items) {
+        return orderRecordCheck(h, items.data(), items.size());
+    }
+
+    static int64_t tell(FILE* f) {
+#ifdef _WIN32
+        return _ftelli64(f);
+#else
+        return (int64_t)ftello(f);
+#endif
+    }
+
+    static bool seek(FILE* f, int64_t offset, int whence = SEEK_SET) {
+#ifdef _WIN32
+        return _fseeki64(f, offset, whence) == 0;
+#else
+        return fseeko(f, (off_t)offset, whence) == 0;
+#endif
+    }
+
+    //under the lock: cuts the file back to size
+    static bool truncate(FILE* f, int64_t size) {
+#ifdef _WIN32
+        return _chsize_s(_fileno(f), size) == 0;
+#else
+        return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+    }
+
+    //a hash table on disk from key to log offset, so opening the log reads a
+    //header instead of every entry. open addressing with linear probing. the
+    //header is read again before each lookup: a writer that fills the table
+    //past half writes one twice the size after it and then points the header
+    //there, and readers holding the file open follow it. the tables left
+    //behind never add up to the size of the live one
+    class IndexFile {
+    private:
+        FILE* f;
+        const char* magic;
+        OrderIndexHeader h;
+
+        uint64_t capacity() const { return (uint64_t)1 << h.slotBits; }
+        static uint64_t home(int64_t key, uint32_t bits) {
+            return ((uint64_t)key * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+        }
+
+        //slot holding key, or the free one where it would go; -1 if unreadable
+        int64_t probe(int64_t key, OrderIndexEntry& found) {
+            OrderIndexEntry run[16];
+            uint64_t i = home(key, h.slotBits);
+            for (uint64_t seen = 0; seen < capacity();) {
+                size_t n = (size_t)(capacity() - i < 16 ? capacity() - i : 16);
+                if (!seek(f, h.tableStart + (int64_t)(i * sizeof(OrderIndexEntry))) ||
+                    fread(run, sizeof(OrderIndexEntry), n, f) != n) {
+                    return -1;
+                }
+                for (size_t j = 0; j < n; j++) {
+                    if (run[j].offset == 0 || run[j].key == key) {
+                        found = run[j];
+                        return (int64_t)(i + j);
+                    }
+                }
+                seen += n;
+                i = (i + n) & (capacity() - 1);
+            }
+            return -1;
+        }
+
+        bool writeHeader() {
+            return seek(f, 0) && fwrite(&h, sizeof(h), 1, f) == 1 && fflush(f) == 0;
+        }
+
+        //writes a table of 1 << bits entries holding entries at start, then
+        //switches the header to it
+        bool rebuild(uint32_t bits, const std::vector<OrderIndexEntry>& entries, int64_t start) {
+            std::vector<OrderIndexEntry> table((size_t)1 << bits);
+            memset(table.data(), 0, table.size() * sizeof(OrderIndexEntry));
+            uint64_t mask = table.size() - 1;
+            for (size_t e = 0; e < entries.size(); e++) {
+                uint64_t i = home(entries[e].key, bits);
+                while (table[i].offset != 0 && table[i].key != entries[e].key) i = (i + 1) & mask;
+                table[i] = entries[e];
+            }
+            if (!seek(f, start) || fwrite(table.data(), sizeof(OrderIndexEntry), table.size(), f) != table.size() ||
+                fflush(f) != 0) {
+                return false;
+            }
+            h.slotBits = bits;
+            h.tableStart = start;
+            h.count = (int64_t)entries.size();
+            return writeHeader();
+        }
+
+        bool grow() {
+            std::vector<OrderIndexEntry> entries;
+            entries.reserve((size_t)h.count);
+            OrderIndexEntry run[4096];
+            for (uint64_t i = 0; i < capacity(); i += 4096) {
+                size_t n = (size_t)(capacity() - i < 4096 ? capacity() - i : 4096);
+                if (!seek(f, h.tableStart + (int64_t)(i * sizeof(OrderIndexEntry))) ||
+                    fread(run, sizeof(OrderIndexEntry), n, f) != n) {
+                    return false;
+                }
+                for (size_t j = 0; j < n; j++) {
+                    if (run[j].offset != 0) entries.push_back(run[j]);
+                }
+            }
+            return seek(f, 0, SEEK_END) && rebuild(h.slotBits + 1, entries, tell(f));
+        }
+
+    public:
+        IndexFile() : f(nullptr), magic("") {
+            memset(&h, 0, sizeof(h));
+        }
+
+        ~IndexFile() {
+            close();
+        }
+
+        //a writer creates the file if there is none
+        bool open(const std::string& path, const char* fileMagic, bool forWriting) {
+            close();
+            magic = fileMagic;
+            f = fopen(path.c_str(), forWriting ? "r+b" : "rb");
+            if (!f && forWriting) f = fopen(path.c_str(), "w+b");
+            if (!f) return false;
+            setvbuf(f, nullptr, _IONBF, 0);   //other processes change it in place
+            return true;
+        }
+
+        void close() {
+            if (f) fclose(f);
+            f = nullptr;
+            h.version = 0;
+        }
+
+        //reads the header again; false if the file does not hold a table
+        bool refresh() {
+            OrderIndexHeader n;
+            if (!f || !seek(f, 0) || fread(&n, sizeof(n), 1, f) != 1 || memcmp(n.magic, magic, 8) != 0 ||
+                n.version != ORDER_INDEX_VERSION || n.slotBits < ORDER_INDEX_MIN_BITS || n.slotBits > 40 ||
+                n.tableStart < (int64_t)sizeof(n)) {
+                h.version = 0;
+                return false;
+            }
+            h = n;
+            return true;
+        }
+
+        //log offset the table covers up to, the start of the log if it cannot be used
+        int64_t covered() const {
+            return h.version == ORDER_INDEX_VERSION ? h.covered : (int64_t)sizeof(OrderLogFileHeader);
+        }
+        int64_t lastRecord() const { return h.lastRecord; }
+
+        //under the lock: an empty table, covering none of the log
+        bool reset() {
+            memset(&h, 0, sizeof(h));
+            memcpy(h.magic, magic, 8);
+            h.version = ORDER_INDEX_VERSION;
+            h.covered = sizeof(OrderLogFileHeader);
+            h.lastRecord = -1;
+            return f && truncate(f, 0) && rebuild(ORDER_INDEX_MIN_BITS, std::vector<OrderIndexEntry>(), sizeof(h));
+        }
+
+        //the offset stored for key, -1 if none
+        int64_t lookup(int64_t key) {
+            OrderIndexEntry e;
+            if (!refresh() || probe(key, e) < 0 || e.offset == 0) return -1;
+            return e.offset;
+        }
+
+        //under the lock, after refresh(): sets key's offset
+        bool put(int64_t key, int64_t offset) {
+            OrderIndexEntry e;
+            int64_t slot = probe(key, e);
+            OrderIndexEntry n = {key, offset};
+            if (slot < 0 || !seek(f, h.tableStart + slot * (int64_t)sizeof(n)) || fwrite(&n, sizeof(n), 1, f) != 1) {
+                return false;
+            }
+            if (e.offset == 0 && ++h.count * 2 > (int64_t)capacity()) return grow();
+            return true;
+        }
+
+        //under the lock: every record before end is in the table, the last at last
+        bool setCovered(int64_t end, int64_t last) {
+            h.covered = end;
+            h.lastRecord = last;
+            return writeHeader();
+        }
+    };
+
+    IndexFile orderTable;
+    IndexFile customerTable;
+
+    static std::string encodeItems(const std::vector<OrderLogItem>& items) {
+        std::string out;
+        for (size_t i = 0; i < items.size(); i++) {
+            OrderItemHeader h;
+            memset(&h, 0, sizeof(h));
+            h.drinkId = items[i].drinkId;
+            h.quantity = (uint16_t)items[i].quantity;
+            h.ice = (uint8_t)items[i].ice;
+            h.sweet = (uint8_t)items[i].sweet;
+            h.lineCents = items[i].lineCents;
+            h.nameLength = (uint8_t)(items[i].name.size() < 255 ? items[i].name.size() : 255);
+            out.append((const char*)&h, sizeof(h));
+            out.append(items[i].name, 0, h.nameLength);
+        }
+        return out;
+    }
+
+    static bool decodeItems(const std::string& in, std::vector<OrderLogItem>& items) {
+        items.clear();
+        size_t pos = 0;
+        while (pos < in.size()) {
+            OrderItemHeader h;
+            if (pos + sizeof(h) > in.size()) return false;
+            memcpy(&h, in.data() + pos, sizeof(h));
+            pos += sizeof(h);
+            if (pos + h.nameLength > in.size()) return false;
+            OrderLogItem item;
+            item.drinkId = h.drinkId;
+            item.quantity = h.quantity;
+            item.ice = h.ice;
+            item.sweet = h.sweet;
+            item.lineCents = h.lineCents;
+            item.name.assign(in.data() + pos, h.nameLength);
+            pos += h.nameLength;
+            items.push_back(item);
+        }
+        return true;
+    }
+
+    static void encode(const OrderLogRecord& r, int64_t prev, OrderRecordHeader& h, std::string& items) {
+        items = encodeItems(r.items);
+        memset(&h, 0, sizeof(h));
+        h.magic = ORDER_RECORD_MAGIC;
+        h.itemsLength = (uint32_t)items.size();
+        h.orderId = r.orderId;
+        h.placed = (int64_t)r.placed;
+        h.totalCents = r.total;
+        h.prevForCustomer = prev;
+        h.customerId = r.customerId;
+        h.itemCount = r.itemCount;
+        h.check = checksum(h, items);
+    }
+
+    //reads the record at offset; false at the end of the log or a torn/corrupt record
+    bool readHeader(int64_t offset, OrderRecordHeader& h, std::string& items) const {
+        if (!seek(data, offset) || fread(&h, sizeof(h), 1, data) != 1) return false;
+        if (h.magic != ORDER_RECORD_MAGIC || h.itemsLength > (1u << 20)) return false;
+        items.resize(h.itemsLength);
+        if (h.itemsLength && fread(&items[0], 1, h.itemsLength, data) != h.itemsLength) return false;
+        return h.check == checksum(h, items);
+    }
+
+    void remember(const OrderRecordHeader& h, int64_t offset) {
+        byOrder[h.orderId] = offset;
+        lastByCustomer[h.customerId] = offset;
+    }
+
+    //the offset of a record for the order, -1 if it is not indexed
+    int64_t orderOffset(int64_t orderId) {
+        std::unordered_map<int64_t, int64_t>::iterator it = byOrder.find(orderId);
+        return it != byOrder.end() ? it->second : orderTable.lookup(orderId);
+    }
+
+    //the customer's newest indexed record, -1 if none. the table may have
+    //moved past what is in memory, so the later of the two
+    int64_t customerLast(int customerId) {
+        int64_t offset = customerTable.lookup(customerId);
+        std::unordered_map<int, int64_t>::iterator it = lastByCustomer.find(customerId);
+        return it != lastByCustomer.end() && it->second > offset ? it->second : offset;
+    }
+
+    //whether the table's header matches the log it indexes
+    bool tableValid(IndexFile& table) {
+        if (!table.refresh() || table.covered() > fileEnd) return false;
+        int64_t last = table.lastRecord();
+        if (last < 0) return table.covered() == (int64_t)sizeof(OrderLogFileHeader);
+        OrderRecordHeader h;
+        std::string items;
+        return readHeader(last, h, items) && last + (int64_t)sizeof(h) + h.itemsLength == table.covered();
+    }
+
+    //under the lock: adds the records up to end that the table misses
+    void completeTable(IndexFile& table, bool customers) {
+        if (!table.refresh()) return;
+        int64_t offset = table.covered();
+        int64_t last = table.lastRecord();
+        OrderRecordHeader h;
+        std::string items;
+        while (offset < end && readHeader(offset, h, items) &&
+               table.put(customers ? (int64_t)h.customerId : h.orderId, offset)) {
+            last = offset;
+            offset += (int64_t)sizeof(h) + h.itemsLength;
+        }
+        if (offset != table.covered()) table.setCovered(offset, last);
+    }
+
+    //under the lock: writes the records up to end to the index files, customer
+    //table first so it is never behind the order table
+    void completeIndex() {
+        completeTable(customerTable, true);
+        completeTable(orderTable, false);
+    }
+
+    //forgets the records in memory once both index files cover them
+    void dropIndexed() {
+        if (byOrder.empty() && lastByCustomer.empty()) return;
+        if (customerTable.refresh() && orderTable.refresh() &&
+            customerTable.covered() >= end && orderTable.covered() >= end) {
+            byOrder.clear();
+            lastByCustomer.clear();
+        }
+    }
+
+    //indexes in memory every record past end, appended by another writer or
+    //left unindexed by an interrupted run
+    void catchUp() {
+        seek(data, 0, SEEK_END);
+        fileEnd = tell(data);
+        OrderRecordHeader h;
+        std::string items;
+        while (end < fileEnd && readHeader(end, h, items)) {
+            remember(h, end);
+            end += (int64_t)sizeof(h) + h.itemsLength;
+        }
+        dropIndexed();
+    }
+
+    static bool createLog(const std::string& path) {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        OrderLogFileHeader fh;
+        memcpy(fh.magic, "ORDERLOG", 8);
+        fh.version = ORDER_LOG_VERSION;
+        fh.pad = 0;
+        bool ok = fwrite(&fh, sizeof(fh), 1, f) == 1;
+        return fclose(f) == 0 && ok;
+    }
+
+    //converts order_history.txt ("cust|order|date|total|count|items|" records)
+    //into a new log, written beside it and renamed into place when complete
+    static bool importText(const std::string& txtPath, const std::string& path) {
+        FILE* in = fopen(txtPath.c_str(), "rb");
+        if (!in) return false;
+        std::string content;
+        char buf[65536];
+        size_t got;
+        while ((got = fread(buf, 1, sizeof(buf), in)) > 0) content.append(buf, got);
+        fclose(in);
+
+        std::string tmpPath = path + ".tmp";
+        if (!createLog(tmpPath)) return false;
+        FILE* out = fopen(tmpPath.c_str(), "ab");
+        if (!out) return false;
+
+        //fields are '|' separated, a record is six of them
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (size_t i = 0; i <= content.size(); i++) {
+            if (i < content.size() && content[i] != '|') continue;
+            size_t a = content.find_first_not_of(" \r\n", start);
+            size_t b = content.find_last_not_of(" \r\n", i ? i - 1 : 0);
+            fields.push_back(a == std::string::npos || a >= i || b < a ? "" : content.substr(a, b - a + 1));
+            start = i + 1;
+        }
+
+        std::unordered_map<int, int64_t> last;
+        int64_t offset = sizeof(OrderLogFileHeader);
+        bool ok = true;
+        for (size_t f = 0; ok && f + 5 < fields.size(); f += 6) {
+            if (fields[f].empty()) break;
+            OrderLogRecord r;
+            r.customerId = atoi(fields[f].c_str());
+            r.orderId = atoll(fields[f + 1].c_str());
+            struct tm t;
+            memset(&t, 0, sizeof(t));
+            if (sscanf(fields[f + 2].c_str(), "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                       &t.tm_hour, &t.tm_min, &t.tm_sec) == 6) {
+                t.tm_year -= 1900;
+                t.tm_mon -= 1;
+                t.tm_isdst = -1;   //written with localtime, read back the same way
+                r.placed = mktime(&t);
+            } else {
+                r.placed = 0;
+            }
+            r.total = 0;
+            parseCents(fields[f + 3].c_str(), r.total);
+            r.itemCount = atoi(fields[f + 4].c_str());
+            parseOrderItems(fields[f + 5], r.items);
+
+            OrderRecordHeader h;
+            std::string items;
+            std::unordered_map<int, int64_t>::iterator prev = last.find(r.customerId);
+            encode(r, prev == last.end() ? -1 : prev->second, h, items);
+            ok = fwrite(&h, sizeof(h), 1, out) == 1 && fwrite(items.data(), 1, items.size(), out) == items.size();
+            last[r.customerId] = offset;
+            offset += (int64_t)sizeof(h) + (int64_t)items.size();
+        }
+        ok = fclose(out) == 0 && ok;
+        if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void lockLog(bool on) {
+#ifdef _WIN32
+        HANDLE h = (HANDLE)_get_osfhandle(_fileno(data));
+        OVERLAPPED ov = {0};
+        if (on) LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+        else UnlockFileEx(h, 0, 1, 0, &ov);
+#else
+        flock(fileno(data), on ? LOCK_EX : LOCK_UN);
+#endif
+    }
+
+    static bool decode(const OrderRecordHeader& h, const std::string& items, int64_t offset, OrderLogRecord& r) {
+        r.orderId = h.orderId;
+        r.customerId = h.customerId;
+        r.placed = (time_t)h.placed;
+        r.total = h.totalCents;
+        r.itemCount = h.itemCount;
+        r.offset = offset;
+        r.prev = h.prevForCustomer;
+        return decodeItems(items, r.items);
+    }
+
+public:
+    OrderLog() : data(nullptr), writable(false), end(0), fileEnd(0) {}
+
+    ~OrderLog() {
+        close();
+    }
+
+    //opens base.log (importing base.txt if there is no log yet) and loads the
+    //indexes. read-only opens never write the indexes, they index in memory
+    bool open(const char* base, bool forWriting) {
+        close();
+        logPath = std::string(base) + ".log";
+        orderIndexPath = std::string(base) + ".oidx";
+        customerIndexPath = std::string(base) + ".cidx";
+        writable = forWriting;
+
+        FILE* probe = fopen(logPath.c_str(), "rb");
+        if (probe) {
+            fclose(probe);
+        } else if (!importText(std::string(base) + ".txt", logPath) && (!writable || !createLog(logPath))) {
+            return false;
+        }
+
+        data = fopen(logPath.c_str(), writable ? "r+b" : "rb");
+        if (!data) return false;
+        OrderLogFileHeader fh;
+        if (fread(&fh, sizeof(fh), 1, data) != 1 || memcmp(fh.magic, "ORDERLOG", 8) != 0 ||
+            fh.version != ORDER_LOG_VERSION) {
+            close();
+            return false;
+        }
+        seek(data, 0, SEEK_END);
+        fileEnd = tell(data);
+
+        if (writable) {
+            //a table that does not match the log is rebuilt, and what a crash
+            //left out is added, before anything is appended
+            lockLog(true);
+            bool ok = customerTable.open(customerIndexPath, "ORDCUSIX", true) &&
+                      orderTable.open(orderIndexPath, "ORDIDIDX", true);
+            if (ok && !tableValid(customerTable)) ok = customerTable.reset();
+            if (ok && !tableValid(orderTable)) ok = orderTable.reset();
+            if (ok) {
+                end = std::min(customerTable.covered(), orderTable.covered());
+                catchUp();
+                completeIndex();
+                dropIndexed();
+            }
+            lockLog(false);
+            if (!ok) {
+                close();
+                return false;
+            }
+        } else {
+            //without usable index files every record is indexed in memory
+            if (!customerTable.open(customerIndexPath, "ORDCUSIX", false) || !tableValid(customerTable)) {
+                customerTable.close();
+            }
+            if (!orderTable.open(orderIndexPath, "ORDIDIDX", false) || !tableValid(orderTable)) {
+                orderTable.close();
+            }
+            end = std::min(customerTable.covered(), orderTable.covered());
+        }
+        catchUp();
+        return true;
+    }
+
+    void close() {
+        if (data) fclose(data);
+        data = nullptr;
+        orderTable.close();
+        customerTable.close();
+        byOrder.clear();
+        lastByCustomer.clear();
+        end = fileEnd = 0;
+    }
+
+    int64_t validEnd() const { return end; }
+    FILE* dataFile() const { return data; }
+
+    //appends records under the log's file lock, after indexing anything other
+    //writers added; offsets are filled in and the index files brought up to
+    //date. a torn tail left by a crashed writer is written over. all or nothing:
+    //if any write fails, none of the records count and the next append writes
+    //over them. the data is flushed to the OS only
+    bool append(std::vector<OrderLogRecord>& records) {
+        if (!data || !writable) return false;
+        lockLog(true);
+        catchUp();
+        int64_t start = end;
+        std::vector<int64_t> added;
+        std::vector<std::pair<int, int64_t>> replaced;   //customer, what memory had for them or -1
+        bool ok = true;
+        for (size_t i = 0; ok && i < records.size(); i++) {
+            OrderRecordHeader h;
+            std::string items;
+            encode(records[i], customerLast(records[i].customerId), h, items);
+            //after the lookups above, which move the file position
+            ok = seek(data, end) && fwrite(&h, sizeof(h), 1, data) == 1 &&
+                 fwrite(items.data(), 1, items.size(), data) == items.size();
+            if (!ok) break;
+            records[i].offset = end;
+            std::unordered_map<int, int64_t>::iterator had = lastByCustomer.find(h.customerId);
+            replaced.push_back(std::make_pair(h.customerId, had == lastByCustomer.end() ? -1 : had->second));
+            added.push_back(h.orderId);
+            remember(h, end);
+            end += (int64_t)sizeof(h) + (int64_t)items.size();
+        }
+        ok = fflush(data) == 0 && ok;
+        if (ok) {
+            fileEnd = end;
+        } else {
+            //forget the batch and cut off what reached the file, so no reader
+            //(or the next catchUp) takes the failed records as written
+            clearerr(data);
+            truncate(data, start);
+            for (size_t i = added.size(); i-- > 0;) {
+                byOrder.erase(added[i]);
+                if (replaced[i].second < 0) lastByCustomer.erase(replaced[i].first);
+                else lastByCustomer[replaced[i].first] = replaced[i].second;
+            }
+            end = start;
+        }
+        completeIndex();
+        dropIndexed();
+        lockLog(false);
+        return ok;
+    }
+
+    //a probe of the order table and one seek
+    bool find(int64_t orderId, OrderLogRecord& out) {
+        if (!data) return false;
+        int64_t offset = orderOffset(orderId);
+        if (offset < 0) {
+            catchUp();   //perhaps just written by another kiosk
+            offset = orderOffset(orderId);
+        }
+        return offset >= 0 && read(offset, out) && out.orderId == orderId;
+    }
+
+    bool read(int64_t offset, OrderLogRecord& out) const {
+        OrderRecordHeader h;
+        std::string items;
+        return data && readHeader(offset, h, items) && decode(h, items, offset, out);
+    }
+
+    //a customer's orders newest first, until visit(record) returns false;
+    //startAt continues from a record's offset (its own record is visited first)
+    template <typename F>
+    int forCustomer(int customerId, F visit, int64_t startAt = -1) {
+        if (!data) return 0;
+        if (startAt < 0) {
+            catchUp();
+            startAt = customerLast(customerId);
+            if (startAt < 0) return 0;
+        }
+        int visited = 0;
+        OrderRecordHeader h;
+        std::string items;
+        OrderLogRecord r;
+        for (int64_t offset = startAt; offset >= 0; offset = h.prevForCustomer) {
+            if (!readHeader(offset, h, items) || h.customerId != customerId || !decode(h, items, offset, r)) break;
+            visited++;
+            if (!visit(r)) break;
+        }
+        return visited;
+    }
+
+    //every record in log order from offset from (a record boundary, such as an
+    //earlier validEnd()), until visit(record) returns false
+    template <typename F>
+    void scan(F visit, int64_t from = 0) {
+        if (!data) return;
+        catchUp();
+        OrderRecordHeader h;
+        std::string items;
+        OrderLogRecord r;
+        if (from < (int64_t)sizeof(OrderLogFileHeader)) from = sizeof(OrderLogFileHeader);
+        for (int64_t offset = from; offset < end;
+             offset += (int64_t)sizeof(h) + h.itemsLength) {
+            if (!readHeader(offset, h, items) || !decode(h, items, offset, r) || !visit(r)) break;
+        }
+    }
+
+    bool isOpen() const { return data != nullptr; }
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef ORDER_PIPELINE_H
+#define ORDER_PIPELINE_H
+
+//checkout as a pipeline: payment workers charge the gateway, a fulfillment
+//worker hands paid orders on, and every outcome comes back on a completion
+//queue the UI polls between screens. the UI thread never waits on either stage.
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <functional>
+#include "money.h"
+#include "order_id.h"
+
+//multi-producer multi-consumer queue with a fixed capacity
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+
+public:
+    explicit BoundedQueue(size_t cap) : capacity(cap), closed(false) {}
+
+    //blocks while full; false once the queue is closed
+    bool push(const T& item) {
+        std::unique_lock<std::mutex> guard(lock);
+        notFull.wait(guard, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    //false instead of waiting when the queue is full
+    bool tryPush(const T& item) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed || items.size() >= capacity) return false;
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    //blocks until an item arrives; false once closed and drained
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> guard(lock);
+        notEmpty.wait(guard, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        out = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty()) return false;
+        out = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    //wakes every waiter; items already queued can still be popped
+    void close() {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+struct PaymentResult {
+    bool approved;
+    std::string message;
+};
+
+//anything that can take a payment; called from payment worker threads
+class PaymentGateway {
+public:
+    virtual ~PaymentGateway() {}
+    virtual PaymentResult charge(OrderId orderId, Cents amount) = 0;
+};
+
+//local stand-in for the card terminal: latency plus jitter and a decline rate
+class SimulatedGateway : public PaymentGateway {
+private:
+    int latencyMs;
+    int jitterMs;
+    int declinePercent;
+    std::mutex rngLock;
+    std::mt19937 rng;
+
+    static int envInt(const char* name, int fallback) {
+        const char* v = getenv(name);
+        return v ? atoi(v) : fallback;
+    }
+
+public:
+    SimulatedGateway(int latency, int jitter, int decline)
+        : latencyMs(latency), jitterMs(jitter), declinePercent(decline),
+          rng((unsigned)std::chrono::steady_clock::now().time_since_epoch().count()) {}
+
+    //configured from MIXUE_GATEWAY_MS, MIXUE_GATEWAY_JITTER_MS and MIXUE_GATEWAY_DECLINE_PCT
+    SimulatedGateway()
+        : latencyMs(envInt("MIXUE_GATEWAY_MS", 800)),
+          jitterMs(envInt("MIXUE_GATEWAY_JITTER_MS", 400)),
+          declinePercent(envInt("MIXUE_GATEWAY_DECLINE_PCT", 0)),
+          rng((unsigned)std::chrono::steady_clock::now().time_since_epoch().count()) {}
+
+    PaymentResult charge(OrderId, Cents amount) {
+        int delay, roll;
+        {
+            std::lock_guard<std::mutex> guard(rngLock);
+            delay = latencyMs + (jitterMs > 0 ? (int)(rng() % (unsigned)(jitterMs + 1)) : 0);
+            roll = (int)(rng() % 100);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        PaymentResult r;
+        r.approved = amount > 0 && roll >= declinePercent;
+        r.message = r.approved ? "approved" : (amount > 0 ? "declined by card issuer" : "nothing to charge");
+        return r;
+    }
+};
+
+template <typename Ticket>
+struct OrderEvent {
+    Ticket ticket;
+    bool paid;
+    std::string message;
+};
+
+//Ticket needs an OrderId id and a Cents total
+template <typename Ticket>
+class OrderPipeline {
+private:
+    PaymentGateway* gateway;
+    std::function<void(const Ticket&)> fulfill;
+    BoundedQueue<Ticket> payments;
+    BoundedQueue<Ticket> paid;
+    BoundedQueue<OrderEvent<Ticket> > completions;  //unbounded, so workers never wait on the UI
+    std::vector<std::thread> paymentWorkers;
+    std::vector<std::thread> fulfillWorkers;
+    std::atomic<int> inFlight;
+
+    void complete(const Ticket& t, bool ok, const std::string& message) {
+        OrderEvent<Ticket> e;
+        e.ticket = t;
+        e.paid = ok;
+        e.message = message;
+        completions.push(e);
+        inFlight--;
+    }
+
+    void paymentLoop() {
+        Ticket t;
+        while (payments.pop(t)) {
+            PaymentResult r = gateway->charge(t.id, t.total);
+            if (!r.approved) {
+                complete(t, false, r.message);
+            } else if (!paid.push(t)) {
+                complete(t, false, "checkout closed");
+            }
+        }
+    }
+
+    void fulfillLoop() {
+        Ticket t;
+        while (paid.pop(t)) {
+            fulfill(t);
+            complete(t, true, "paid");
+        }
+    }
+
+public:
+    OrderPipeline(PaymentGateway* g, std::function<void(const Ticket&)> onPaid,
+                  int paymentThreads = 2, int fulfillThreads = 1, size_t capacity = 32)
+        : gateway(g), fulfill(onPaid), payments(capacity), paid(capacity),
+          completions((size_t)-1), inFlight(0) {
+        for (int i = 0; i < paymentThreads; i++) {
+            paymentWorkers.push_back(std::thread(&OrderPipeline::paymentLoop, this));
+        }
+        for (int i = 0; i < fulfillThreads; i++) {
+            fulfillWorkers.push_back(std::thread(&OrderPipeline::fulfillLoop, this));
+        }
+    }
+
+    ~OrderPipeline() {
+        shutdown();
+    }
+
+    //false if checkout is saturated; the caller keeps the order
+    bool submit(const Ticket& t) {
+        inFlight++;
+        if (!payments.tryPush(t)) {
+            inFlight--;
+            return false;
+        }
+        return true;
+    }
+
+    //non-blocking, for the UI thread
+    bool poll(OrderEvent<Ticket>& e) {
+        return completions.tryPop(e);
+    }
+
+    int pending() const { return inFlight; }
+
+    //lets every submitted order finish, then stops the workers
+    void shutdown() {
+        payments.close();
+        for (size_t i = 0; i < paymentWorkers.size(); i++) paymentWorkers[i].join();
+        paymentWorkers.clear();
+        paid.close();
+        for (size_t i = 0; i < fulfillWorkers.size(); i++) fulfillWorkers[i].join();
+        fulfillWorkers.clear();
+    }
+};
+
+#endif
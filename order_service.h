@@ -0,0 +1,552 @@
+#ifndef ORDER_SERVICE_H
+#define ORDER_SERVICE_H
+
+//local order service: one process owns customers, carts, stock and checkout,
+//and kiosks on the same machine talk to it over a unix domain socket. every
+//message is a 12-byte header (payload length, request type, status, tag)
+//followed by the payload: little-endian integers and length-prefixed strings.
+//a reply carries the tag of its request. the server is one epoll loop with
+//non-blocking sockets and per-connection buffers; a kiosk that does not take
+//its replies is not read from until they drain. requests are handled in
+//arrival order on the loop thread, so handlers use the program's data as the
+//UI thread would, without locks. a tick callback runs between batches of
+//events (and at least every tickMs) for work like collecting payments.
+//runServiceLoad() drives N simulated kiosks against a running service and
+//reports requests per second and latency percentiles. linux only (epoll);
+//elsewhere listen() and connect() fail and the caller stays local.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "cart_journal.h"
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#endif
+
+enum ServiceRequest {
+    SVC_LOGIN = 1,      //email, password -> customer id, name
+    SVC_MENU,           //known version -> version, count, DrinkRecord bytes (count 0 if unchanged)
+    SVC_CART_GET,       //-> cart lines
+    SVC_CART_CHANGE,    //op, arg, quantity, custom -> result, cart lines
+    SVC_CHECKOUT        //-> order id, total cents
+};
+
+enum ServiceStatus {
+    SVC_OK = 0,
+    SVC_FAILED,         //refused: wrong password, out of stock, empty cart...
+    SVC_LOGIN_REQUIRED,
+    SVC_BUSY,           //checkout saturated, try again
+    SVC_BAD_REQUEST
+};
+
+struct ServiceHeader {
+    uint32_t length;    //payload bytes that follow
+    uint16_t type;
+    uint16_t status;    //replies only
+    uint32_t tag;
+};
+
+const uint32_t SERVICE_MAX_MESSAGE = 1 << 20;
+const size_t SERVICE_MAX_PENDING = 1 << 20;   //unsent reply bytes before a connection stops being read
+
+//payload being built
+class ServiceBuffer {
+public:
+    std::string data;
+
+    void put32(int32_t v) { data.append((const char*)&v, 4); }
+    void put64(int64_t v) { data.append((const char*)&v, 8); }
+    void putBytes(const void* p, size_t n) { data.append((const char*)p, n); }
+    void putString(const std::string& s) {
+        put32((int32_t)s.size());
+        data.append(s);
+    }
+    void clear() { data.clear(); }
+};
+
+//payload being read; a short payload sets ok to false and reads as zeros
+class ServiceReader {
+private:
+    const char* p;
+    const char* end;
+
+public:
+    bool ok;
+
+    ServiceReader(const char* data, size_t length) : p(data), end(data + length), ok(true) {}
+    explicit ServiceReader(const std::string& s) : p(s.data()), end(s.data() + s.size()), ok(true) {}
+
+    const char* getBytes(size_t n) {
+        if ((size_t)(end - p) < n) {
+            ok = false;
+            return nullptr;
+        }
+        const char* at = p;
+        p += n;
+        return at;
+    }
+    int32_t get32() {
+        int32_t v = 0;
+        const char* at = getBytes(4);
+        if (at) memcpy(&v, at, 4);
+        return v;
+    }
+    int64_t get64() {
+        int64_t v = 0;
+        const char* at = getBytes(8);
+        if (at) memcpy(&v, at, 8);
+        return v;
+    }
+    std::string getString() {
+        int32_t n = get32();
+        const char* at = n >= 0 ? getBytes((size_t)n) : nullptr;
+        return at ? std::string(at, (size_t)n) : std::string();
+    }
+};
+
+//what the server remembers about one kiosk connection
+struct ServiceSession {
+    int customerId;     //0 until a login succeeds
+    ServiceSession() : customerId(0) {}
+};
+
+class ServiceServer {
+private:
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t sent;
+        ServiceSession session;
+    };
+
+    int listenFd;
+    int epollFd;
+    std::string path;
+    std::unordered_map<int, Connection> connections;
+
+#ifdef __linux__
+    static void nonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    static size_t pending(const Connection& c) { return c.out.size() - c.sent; }
+
+    void watch(Connection& c) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = (pending(c) < SERVICE_MAX_PENDING ? (uint32_t)EPOLLIN : (uint32_t)0) |
+                    (pending(c) > 0 ? (uint32_t)EPOLLOUT : (uint32_t)0);
+        ev.data.fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    //false once the peer is gone
+    bool flushOut(Connection& c) {
+        while (c.sent < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.sent += (size_t)n;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        if (c.sent == c.out.size()) {
+            c.out.clear();
+            c.sent = 0;
+        }
+        return true;
+    }
+
+    //handles every whole request in the buffer, in order, until the replies
+    //waiting to be sent reach SERVICE_MAX_PENDING; false on a bad header
+    template <typename Handle>
+    bool serveBuffered(Connection& c, Handle& handle) {
+        size_t at = 0;
+        ServiceBuffer reply;
+        while (c.in.size() - at >= sizeof(ServiceHeader) && pending(c) < SERVICE_MAX_PENDING) {
+            ServiceHeader h;
+            memcpy(&h, c.in.data() + at, sizeof(h));
+            if (h.length > SERVICE_MAX_MESSAGE) return false;
+            if (c.in.size() - at - sizeof(h) < h.length) break;
+            ServiceReader request(c.in.data() + at + sizeof(h), h.length);
+            reply.clear();
+            uint16_t status = (uint16_t)handle(c.session, h.type, request, reply);
+            if (!request.ok) {
+                status = SVC_BAD_REQUEST;
+                reply.clear();
+            }
+            ServiceHeader r;
+            r.length = (uint32_t)reply.data.size();
+            r.type = h.type;
+            r.status = status;
+            r.tag = h.tag;
+            c.out.append((const char*)&r, sizeof(r));
+            c.out.append(reply.data);
+            at += sizeof(h) + h.length;
+        }
+        c.in.erase(0, at);
+        return true;
+    }
+
+    //reads and serves while the replies keep up; a kiosk that sends faster
+    //than it reads is left in the socket buffer until watch() reads it again
+    template <typename Handle>
+    bool readIn(Connection& c, Handle& handle) {
+        char chunk[16384];
+        while (pending(c) < SERVICE_MAX_PENDING) {
+            ssize_t n = recv(c.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                c.in.append(chunk, (size_t)n);
+                if (!serveBuffered(c, handle)) return false;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return false;
+            }
+        }
+        return flushOut(c);
+    }
+#endif
+
+public:
+    ServiceServer() : listenFd(-1), epollFd(-1) {}
+
+    ~ServiceServer() {
+        close();
+    }
+
+    //binds the socket, replacing one left behind by an earlier run
+    bool listen(const char* socketPath) {
+        close();
+#ifdef __linux__
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(socketPath) >= sizeof(addr.sun_path)) return false;
+        strcpy(addr.sun_path, socketPath);
+
+        path = socketPath;
+        unlink(socketPath);
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        epollFd = epoll_create1(0);
+        if (listenFd < 0 || epollFd < 0 || bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            ::listen(listenFd, 128) != 0) {
+            close();
+            return false;
+        }
+        nonBlocking(listenFd);
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        return true;
+#else
+        (void)socketPath;
+        return false;
+#endif
+    }
+
+    void close() {
+#ifdef __linux__
+        for (std::unordered_map<int, Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+            ::close(it->first);
+        }
+        if (listenFd >= 0) ::close(listenFd);
+        if (epollFd >= 0) ::close(epollFd);
+        if (!path.empty()) unlink(path.c_str());
+#endif
+        connections.clear();
+        listenFd = epollFd = -1;
+        path.clear();
+    }
+
+    int connectionCount() const { return (int)connections.size(); }
+
+    //serves until stop is set. handle(session, type, request, reply) returns a
+    //ServiceStatus; closed(session) runs when a kiosk disconnects
+    template <typename Handle, typename Tick, typename Closed>
+    void run(Handle handle, Tick tick, Closed closed, const std::atomic<bool>& stop, int tickMs = 100) {
+#ifdef __linux__
+        struct epoll_event events[64];
+        while (!stop.load() && epollFd >= 0) {
+            int n = epoll_wait(epollFd, events, 64, tickMs);
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    int client;
+                    while ((client = accept(listenFd, nullptr, nullptr)) >= 0) {
+                        nonBlocking(client);
+                        Connection& c = connections[client];
+                        c.fd = client;
+                        c.sent = 0;
+                        struct epoll_event ev;
+                        memset(&ev, 0, sizeof(ev));
+                        ev.events = EPOLLIN;
+                        ev.data.fd = client;
+                        epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &ev);
+                    }
+                    continue;
+                }
+
+                std::unordered_map<int, Connection>::iterator it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& c = it->second;
+                bool alive = !(events[i].events & (EPOLLHUP | EPOLLERR)) || (events[i].events & EPOLLIN);
+                if (alive && (events[i].events & EPOLLIN)) alive = readIn(c, handle);
+                if (alive && (events[i].events & EPOLLOUT)) alive = flushOut(c);
+                //requests held back while the replies drained
+                if (alive && !c.in.empty() && pending(c) < SERVICE_MAX_PENDING) {
+                    alive = serveBuffered(c, handle) && flushOut(c);
+                }
+                if (!alive) {
+                    closed(c.session);
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                    ::close(fd);
+                    connections.erase(it);
+                    continue;
+                }
+                watch(c);
+            }
+            tick();
+        }
+#else
+        (void)handle;
+        (void)tick;
+        (void)closed;
+        (void)stop;
+        (void)tickMs;
+#endif
+    }
+};
+
+class ServiceClient {
+private:
+    int fd;
+    uint32_t nextTag;
+
+public:
+    ServiceClient() : fd(-1), nextTag(1) {}
+
+    ~ServiceClient() {
+        close();
+    }
+
+    bool connect(const char* socketPath) {
+        close();
+#ifdef __linux__
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(socketPath) >= sizeof(addr.sun_path)) return false;
+        strcpy(addr.sun_path, socketPath);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) close();
+#else
+        (void)socketPath;
+#endif
+        return fd >= 0;
+    }
+
+    void close() {
+#ifdef __linux__
+        if (fd >= 0) ::close(fd);
+#endif
+        fd = -1;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    //sends one request and waits for its reply; false (and closed) if the
+    //service went away
+    bool call(uint16_t type, const ServiceBuffer& request, uint16_t& status, std::string& reply) {
+#ifdef __linux__
+        if (fd < 0) return false;
+        ServiceHeader h;
+        h.length = (uint32_t)request.data.size();
+        h.type = type;
+        h.status = 0;
+        h.tag = nextTag++;
+        std::string out((const char*)&h, sizeof(h));
+        out.append(request.data);
+        for (size_t sent = 0; sent < out.size();) {
+            ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close();
+                return false;
+            }
+            sent += (size_t)n;
+        }
+
+        ServiceHeader r;
+        if (!receive(&r, sizeof(r)) || r.length > SERVICE_MAX_MESSAGE || r.tag != h.tag) {
+            close();
+            return false;
+        }
+        reply.resize(r.length);
+        if (r.length && !receive(&reply[0], r.length)) {
+            close();
+            return false;
+        }
+        status = r.status;
+        return true;
+#else
+        (void)type;
+        (void)request;
+        (void)status;
+        (void)reply;
+        return false;
+#endif
+    }
+
+private:
+    bool receive(void* to, size_t n) {
+#ifdef __linux__
+        char* p = (char*)to;
+        while (n > 0) {
+            ssize_t got = recv(fd, p, n, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            p += got;
+            n -= (size_t)got;
+        }
+        return true;
+#else
+        (void)to;
+        (void)n;
+        return false;
+#endif
+    }
+};
+
+struct ServiceAccount {
+    std::string email;
+    std::string password;
+};
+
+struct ServiceLoadResult {
+    int kiosks;
+    double seconds;
+    int64_t requests;
+    int64_t refused;        //answered with a status other than SVC_OK
+    int64_t failures;       //connection lost or never made
+    std::vector<double> latencyMs;   //sorted
+
+    ServiceLoadResult() : kiosks(0), seconds(0), requests(0), refused(0), failures(0) {}
+
+    double perSecond() const { return seconds > 0 ? requests / seconds : 0; }
+
+    double percentile(double p) const {
+        if (latencyMs.empty()) return 0;
+        size_t i = (size_t)(p / 100.0 * (latencyMs.size() - 1) + 0.5);
+        return latencyMs[std::min(i, latencyMs.size() - 1)];
+    }
+};
+
+//kiosks simulated kiosks, each on its own connection and thread, for about
+//seconds: log in once, then repeat a session of menu fetch, two adds, a cart
+//read and a checkout. every request is timed from send to reply
+inline ServiceLoadResult runServiceLoad(const char* socketPath, int kiosks, double seconds,
+                                        const std::vector<ServiceAccount>& accounts,
+                                        const std::vector<int>& drinkIds) {
+    ServiceLoadResult result;
+    result.kiosks = kiosks;
+    if (accounts.empty() || drinkIds.empty() || kiosks <= 0) return result;
+
+    struct KioskStats {
+        int64_t requests, refused, failures;
+        std::vector<double> latencyMs;
+        KioskStats() : requests(0), refused(0), failures(0) {}
+    };
+    std::vector<KioskStats> stats(kiosks);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline =
+        start + std::chrono::microseconds((int64_t)(seconds * 1e6));
+
+    std::vector<std::thread> threads;
+    for (int k = 0; k < kiosks; k++) {
+        threads.push_back(std::thread([&, k] {
+            KioskStats& s = stats[k];
+            ServiceClient client;
+            if (!client.connect(socketPath)) {
+                s.failures++;
+                return;
+            }
+            uint16_t status;
+            std::string reply;
+            auto timed = [&](uint16_t type, const ServiceBuffer& request) {
+                std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                bool ok = client.call(type, request, status, reply);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                if (!ok) {
+                    s.failures++;
+                    return false;
+                }
+                s.requests++;
+                s.latencyMs.push_back(ms);
+                if (status != SVC_OK) s.refused++;
+                return true;
+            };
+
+            const ServiceAccount& account = accounts[k % accounts.size()];
+            ServiceBuffer login;
+            login.putString(account.email);
+            login.putString(account.password);
+            if (!timed(SVC_LOGIN, login)) return;
+
+            int64_t menuVersion = 0;
+            unsigned seed = (unsigned)k * 2654435761u + 1;
+            while (std::chrono::steady_clock::now() < deadline) {
+                ServiceBuffer menu;
+                menu.put64(menuVersion);
+                if (!timed(SVC_MENU, menu)) return;
+                if (status == SVC_OK) menuVersion = ServiceReader(reply).get64();
+
+                for (int i = 0; i < 2; i++) {
+                    seed = seed * 1103515245u + 12345u;
+                    ServiceBuffer add;
+                    add.put32(CART_ADD);
+                    add.put32(drinkIds[(seed >> 8) % drinkIds.size()]);
+                    add.put32(1 + (int)((seed >> 20) % 2));
+                    add.put32(1 | (1 << 4));
+                    if (!timed(SVC_CART_CHANGE, add)) return;
+                }
+                if (!timed(SVC_CART_GET, ServiceBuffer())) return;
+                if (!timed(SVC_CHECKOUT, ServiceBuffer())) return;
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int k = 0; k < kiosks; k++) {
+        result.requests += stats[k].requests;
+        result.refused += stats[k].refused;
+        result.failures += stats[k].failures;
+        result.latencyMs.insert(result.latencyMs.end(), stats[k].latencyMs.begin(), stats[k].latencyMs.end());
+    }
+    std::sort(result.latencyMs.begin(), result.latencyMs.end());
+    return result;
+}
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+//console input for both programs, on Windows consoles and Linux terminals,
+//and the headless driver built on it. getKey() and keyPressed() stand in for
+//conio's _getch() and _kbhit(): one key, not echoed, Enter as '\r'. line
+//input still goes through cin, but cin reads from a ConsoleInput buffer that
+//can take its input from three places:
+//  - the console, as before; with --record file every line and key is also
+//    written to file with the milliseconds the user took to enter it.
+//    PASSWORDS ARE NOT RECORDED: what is typed while a HiddenInput lives (the
+//    password prompts) is written as *, so a recording that logs in needs the
+//    real password put back by hand before it can be replayed
+//  - a script (--script file), replayed as fast as the program reads it:
+//    no waiting, sleepMs() returns at once, keyPressed() is always true
+//  - a recording (--replay file), replayed with its original timings
+//when a script runs out, the program's end hook runs, the input count and
+//rate go to stderr, and the process exits.
+//
+//script lines, which are also what --record writes:
+//  text        typed as a line (Enter is implied); an empty line is Enter alone
+//  ~keys       pressed as keys, e.g. a password ~secret\r or ~\r for any key
+//  @ms ...     either of the above, entered ms after the previous input
+//  #...        a comment
+//escapes: \\ \r \n \t and \xHH; a line that starts with ~ @ # is written \x7e...
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <streambuf>
+#include <iostream>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#endif
+
+struct ScriptEntry {
+    long delayMs;
+    bool key;           //keys for getKey(), else a line for cin
+    std::string text;   //a line includes its '\n'
+};
+
+inline std::string scriptEscape(const std::string& text, bool key) {
+    std::string out;
+    char hex[8];
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        bool marker = i == 0 && !key && (c == '~' || c == '@' || c == '#');
+        if (c == '\\') out += "\\\\";
+        else if (c == '\r') out += "\\r";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20 || c >= 0x7f || marker) {
+            snprintf(hex, sizeof(hex), "\\x%02x", c);
+            out += hex;
+        } else {
+            out += (char)c;
+        }
+    }
+    return out;
+}
+
+inline std::string scriptUnescape(const char* p) {
+    std::string out;
+    for (; *p; p++) {
+        if (*p != '\\' || !p[1]) {
+            out += *p;
+            continue;
+        }
+        p++;
+        if (*p == 'r') out += '\r';
+        else if (*p == 'n') out += '\n';
+        else if (*p == 't') out += '\t';
+        else if (*p == 'x' && p[1] && p[2]) {
+            char hex[3] = {p[1], p[2], 0};
+            out += (char)strtol(hex, nullptr, 16);
+            p += 2;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+//reads a script or recording; false if the file cannot be opened
+inline bool readScript(const char* path, std::vector<ScriptEntry>& entries) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    std::string line;
+    int c;
+    do {
+        c = fgetc(f);
+        if (c != '\n' && c != EOF) {
+            line += (char)c;
+            continue;
+        }
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        const char* p = line.c_str();
+        ScriptEntry e;
+        e.delayMs = 0;
+        if (*p == '@') {
+            e.delayMs = strtol(p + 1, (char**)&p, 10);
+            if (*p == ' ') p++;
+        }
+        if (*p != '#' && !(c == EOF && line.empty())) {
+            e.key = *p == '~';
+            e.text = scriptUnescape(e.key ? p + 1 : p);
+            if (!e.key) e.text += '\n';
+            entries.push_back(e);
+        }
+        line.clear();
+    } while (c != EOF);
+    fclose(f);
+    return true;
+}
+
+class ConsoleInput : public std::streambuf {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::streambuf* original;       //cin's own buffer, for console lines on Windows
+    std::vector<ScriptEntry> script;
+    size_t nextEntry;
+    bool scripted;
+    bool timed;
+    FILE* record;
+    bool hidden;                    //input is a password, recorded as *
+    void (*endHook)();
+    std::string line;               //what cin is reading
+    std::string keys;               //keys of a script entry not yet taken
+    size_t keyPos;
+    Clock::time_point lastInput;
+    Clock::time_point started;
+#ifndef _WIN32
+    bool raw;
+    struct termios saved;
+#endif
+
+    long sinceLastInput() const {
+        return (long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastInput).count();
+    }
+
+    void recordEntry(const std::string& text, bool key) {
+        if (!record) return;
+        std::string body = key ? text : text.substr(0, text.size() - (text.back() == '\n' ? 1 : 0));
+        for (size_t i = 0; hidden && i < body.size(); i++) {
+            if (body[i] != '\r' && body[i] != '\n' && body[i] != '\b' && body[i] != 127) body[i] = '*';
+        }
+        bool unterminated = !key && (text.empty() || text.back() != '\n');
+        fprintf(record, "@%ld %s%s\n", sinceLastInput(), key || unterminated ? "~" : "",
+                scriptEscape(body, key || unterminated).c_str());
+        fflush(record);   //a session that is killed keeps what it recorded
+    }
+
+    //the next script entry, after its recorded delay when replaying; the end
+    //hook runs when there is none
+    const ScriptEntry& takeEntry() {
+        if (nextEntry >= script.size()) finish();
+        const ScriptEntry& e = script[nextEntry++];
+        if (timed) {
+            long wait = e.delayMs - sinceLastInput();
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+        }
+        lastInput = Clock::now();
+        return e;
+    }
+
+    void finish() {
+        double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        std::cout << std::flush;
+        fprintf(stderr, "\nscript: %zu inputs in %.3f s (%.0f inputs/s)\n", script.size(), seconds,
+                seconds > 0 ? script.size() / seconds : 0.0);
+        if (endHook) endHook();
+        exit(0);
+    }
+
+    //one line from the console, up to and including '\n'; empty at the end
+    std::string consoleLine() {
+        std::string s;
+#ifdef _WIN32
+        int c;
+        while ((c = original->sbumpc()) != EOF) {
+            s += (char)c;
+            if (c == '\n') break;
+        }
+#else
+        //byte by byte, so nothing past the line is read ahead of getKey()
+        char c;
+        while (::read(0, &c, 1) == 1) {
+            s += c;
+            if (c == '\n') break;
+        }
+#endif
+        return s;
+    }
+
+#ifndef _WIN32
+    void rawMode(bool on) {
+        if (on == raw || !isatty(0)) return;
+        if (on) {
+            tcgetattr(0, &saved);
+            struct termios t = saved;
+            t.c_lflag &= ~(ICANON | ECHO);
+            t.c_cc[VMIN] = 1;
+            t.c_cc[VTIME] = 0;
+            tcsetattr(0, TCSANOW, &t);
+        } else {
+            tcsetattr(0, TCSANOW, &saved);
+        }
+        raw = on;
+    }
+#endif
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        if (scripted) {
+            line = takeEntry().text;
+        } else {
+            line = consoleLine();
+            if (line.empty()) return traits_type::eof();
+            recordEntry(line, false);
+            lastInput = Clock::now();
+        }
+        if (line.empty()) return underflow();
+        setg(&line[0], &line[0], &line[0] + line.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    ConsoleInput()
+        : original(nullptr), nextEntry(0), scripted(false), timed(false), record(nullptr), hidden(false),
+          endHook(nullptr), keyPos(0) {
+        lastInput = started = Clock::now();
+#ifndef _WIN32
+        raw = false;
+#endif
+    }
+
+    ~ConsoleInput() {
+        if (original) std::cin.rdbuf(original);
+#ifndef _WIN32
+        rawMode(false);
+#endif
+        if (record) fclose(record);
+    }
+
+    //takes over cin; called once, before anything is read
+    void install() {
+        if (!original) original = std::cin.rdbuf(this);
+    }
+
+    bool useScript(const char* path, bool withTimings) {
+        if (!readScript(path, script)) return false;
+        scripted = true;
+        timed = withTimings;
+        return true;
+    }
+
+    bool startRecording(const char* path) {
+        record = fopen(path, "wb");
+        if (!record) return false;
+        fprintf(record, "# recorded session, replay with --replay %s\n", path);
+        fprintf(record, "# PASSWORDS ARE MASKED: input at password prompts is recorded as *,\n"
+                        "# type the real ones over the * entries before replaying a login\n");
+        return true;
+    }
+
+    void onScriptEnd(void (*hook)()) { endHook = hook; }
+    void hideInput(bool on) { hidden = on; }
+    bool fast() const { return scripted && !timed; }
+
+    int getKey() {
+        if (scripted) {
+            if (keyPos < keys.size()) return (unsigned char)keys[keyPos++];
+            if (nextEntry < script.size() && !script[nextEntry].key) return '\r';   //a line where a key was due
+            keys = takeEntry().text;
+            keyPos = 0;
+            return getKey();
+        }
+        int c;
+#ifdef _WIN32
+        c = _getch();
+#else
+        unsigned char b = '\r';
+        rawMode(true);
+        if (::read(0, &b, 1) != 1) b = '\r';
+        rawMode(false);
+        c = b == '\n' ? '\r' : b;
+#endif
+        recordEntry(std::string(1, (char)c), true);
+        lastInput = Clock::now();
+        return c;
+    }
+
+    bool keyPressed() {
+        if (scripted) {
+            if (!timed || keyPos < keys.size() || nextEntry >= script.size()) return true;
+            return sinceLastInput() >= script[nextEntry].delayMs;
+        }
+#ifdef _WIN32
+        return _kbhit() != 0;
+#else
+        rawMode(true);   //left on so a key counts without Enter; getKey() turns it off
+        struct pollfd p = {0, POLLIN, 0};
+        return poll(&p, 1, 0) > 0;
+#endif
+    }
+};
+
+inline ConsoleInput& console() {
+    static ConsoleInput input;
+    return input;
+}
+
+//while one lives, keys and lines are recorded as *; put one around every
+//password prompt
+class HiddenInput {
+public:
+    HiddenInput() { console().hideInput(true); }
+    ~HiddenInput() { console().hideInput(false); }
+};
+
+//one keypress, not echoed; Enter is '\r'
+inline int getKey() {
+    return console().getKey();
+}
+
+//true if getKey() would not wait
+inline bool keyPressed() {
+    return console().keyPressed();
+}
+
+//a pause for the user's benefit, skipped when a script runs at full speed
+inline void sleepMs(int ms) {
+    if (!console().fast()) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+//takes --script, --replay and --record out of argv and sets up the console;
+//hook runs before exit when a script ends. false (with a message) on a bad file
+inline bool consoleArgs(int& argc, char* argv[], void (*hook)()) {
+    ConsoleInput& input = console();
+    input.onScriptEnd(hook);
+    int kept = 1;
+    bool ok = true;
+    for (int i = 1; i < argc; i++) {
+        bool script = strcmp(argv[i], "--script") == 0;
+        bool replay = strcmp(argv[i], "--replay") == 0;
+        bool record = strcmp(argv[i], "--record") == 0;
+        if (!(script || replay || record)) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+        const char* path = i + 1 < argc ? argv[++i] : nullptr;
+        bool opened = path && (record ? input.startRecording(path) : input.useScript(path, replay));
+        if (!opened) {
+            fprintf(stderr, "%s: cannot open %s\n", argv[i - (path ? 1 : 0)], path ? path : "(no file given)");
+            ok = false;
+        }
+    }
+    argc = kept;
+    argv[argc] = nullptr;
+    input.install();
+    return ok;
+}
+
+#endif
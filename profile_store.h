@@ -0,0 +1,448 @@
+#ifndef PROFILE_STORE_H
+#define PROFILE_STORE_H
+
+//customer profiles in one packed segment instead of an <email>.txt per customer.
+//  profiles.dat   - "PROFILES" header, then records: a fixed header followed
+//                   by the email and name. an update appends a new record;
+//                   the newest record for an email is the profile
+//  profiles.pidx  - (hash of email, offset) per record, in segment order
+//the index is loaded at open and anything the index has not caught up with is
+//indexed in memory from the segment tail, so opening a profile is one hash
+//lookup and one seek. puts are queued and written together by flush(), under
+//a file lock shared with the other kiosks; the index file is only appended
+//under that lock, from the record after its own last entry, so every record
+//is in it once whichever kiosk wrote it. migrateProfileFiles() imports the old
+//<email>.txt files once; exportProfileFiles() writes them back out on demand.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+const uint32_t PROFILE_STORE_VERSION = 1;
+const size_t PROFILE_MAX_EMAIL = 255;              //a record keeps its length in a byte
+const uint32_t PROFILE_RECORD_MAGIC = 0x464F5250;  //"PROF"
+
+struct Profile {
+    int customerId;
+    std::string email;
+    std::string name;
+    time_t memberSince;
+};
+
+struct ProfileFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pad;
+};
+
+struct ProfileRecordHeader {
+    uint32_t magic;
+    int32_t customerId;
+    int64_t memberSince;
+    uint8_t emailLength;    //email bytes, then name bytes, follow
+    uint8_t nameLength;
+    uint16_t pad;
+    uint32_t check;         //FNV-1a over the fields above and the strings
+};
+
+struct ProfileIndexEntry {
+    uint64_t emailHash;
+    int64_t offset;
+};
+
+inline uint64_t profileEmailHash(const std::string& email) {
+    //FNV-1a, 64-bit
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < email.size(); i++) h = (h ^ (unsigned char)email[i]) * 1099511628211ull;
+    return h;
+}
+
+inline uint32_t profileRecordCheck(const ProfileRecordHeader& h, const char* strings, size_t length) {
+    uint32_t c = 2166136261u;
+    const unsigned char* p = (const unsigned char*)&h;
+    for (size_t i = 0; i < offsetof(ProfileRecordHeader, check); i++) c = (c ^ p[i]) * 16777619u;
+    for (size_t i = 0; i < length; i++) c = (c ^ (unsigned char)strings[i]) * 16777619u;
+    return c;
+}
+
+class ProfileStore {
+private:
+    std::string dataPath, indexPath;
+    FILE* data;
+    FILE* index;
+    int64_t end;            //end of the last valid record
+    std::unordered_multimap<uint64_t, int64_t> byEmail;   //every record; the largest offset wins
+    std::vector<Profile> pending;
+
+    static int64_t tell(FILE* f) {
+#ifdef _WIN32
+        return _ftelli64(f);
+#else
+        return (int64_t)ftello(f);
+#endif
+    }
+
+    static bool seek(FILE* f, int64_t offset, int whence = SEEK_SET) {
+#ifdef _WIN32
+        return _fseeki64(f, offset, whence) == 0;
+#else
+        return fseeko(f, (off_t)offset, whence) == 0;
+#endif
+    }
+
+    void lock(bool on) {
+#ifdef _WIN32
+        HANDLE h = (HANDLE)_get_osfhandle(_fileno(data));
+        OVERLAPPED ov = {0};
+        if (on) LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+        else UnlockFileEx(h, 0, 1, 0, &ov);
+#else
+        flock(fileno(data), on ? LOCK_EX : LOCK_UN);
+#endif
+    }
+
+    //the record at offset; false at the end of the segment or a torn record
+    bool readRecord(int64_t offset, Profile& out, int64_t* next = nullptr) const {
+        ProfileRecordHeader h;
+        if (!seek(data, offset) || fread(&h, sizeof(h), 1, data) != 1 || h.magic != PROFILE_RECORD_MAGIC) {
+            return false;
+        }
+        char strings[512];
+        size_t length = (size_t)h.emailLength + h.nameLength;
+        if (fread(strings, 1, length, data) != length || h.check != profileRecordCheck(h, strings, length)) {
+            return false;
+        }
+        out.customerId = h.customerId;
+        out.memberSince = (time_t)h.memberSince;
+        out.email.assign(strings, h.emailLength);
+        out.name.assign(strings + h.emailLength, h.nameLength);
+        if (next) *next = offset + (int64_t)sizeof(h) + (int64_t)length;
+        return true;
+    }
+
+    void remember(const std::string& email, int64_t offset) {
+        byEmail.insert(std::make_pair(profileEmailHash(email), offset));
+    }
+
+    //indexes in memory the records past end, written by another kiosk or before a crash
+    void catchUp() {
+        Profile p;
+        int64_t next;
+        while (readRecord(end, p, &next)) {
+            remember(p.email, end);
+            end = next;
+        }
+    }
+
+    //under the lock: the end of the last record the index file covers. a torn
+    //last entry is cut off so the next one lands in place
+    int64_t indexedEnd() {
+        seek(index, 0, SEEK_END);
+        int64_t size = tell(index);
+        int64_t entries = size / (int64_t)sizeof(ProfileIndexEntry);
+        if (size != entries * (int64_t)sizeof(ProfileIndexEntry)) {
+            fflush(index);
+#ifdef _WIN32
+            _chsize_s(_fileno(index), entries * (int64_t)sizeof(ProfileIndexEntry));
+#else
+            if (ftruncate(fileno(index), (off_t)(entries * (int64_t)sizeof(ProfileIndexEntry))) != 0) return end;
+#endif
+        }
+        ProfileIndexEntry e;
+        Profile p;
+        int64_t next;
+        if (entries == 0) return sizeof(ProfileFileHeader);
+        if (!seek(index, (entries - 1) * (int64_t)sizeof(e)) || fread(&e, sizeof(e), 1, index) != 1 ||
+            !readRecord(e.offset, p, &next)) {
+            return end;   //unreadable: add nothing rather than duplicates
+        }
+        return next;
+    }
+
+    //under the lock: appends index entries for the records up to end that the
+    //index file does not have yet, whoever wrote them
+    void indexTail() {
+        if (!index) return;
+        Profile p;
+        int64_t next;
+        int64_t offset = indexedEnd();
+        seek(index, 0, SEEK_END);
+        for (; offset < end && readRecord(offset, p, &next); offset = next) {
+            ProfileIndexEntry e = {profileEmailHash(p.email), offset};
+            fwrite(&e, sizeof(e), 1, index);
+        }
+        fflush(index);
+    }
+
+    //offset of the newest record for email, -1 if none
+    int64_t locate(const std::string& email) {
+        std::pair<std::unordered_multimap<uint64_t, int64_t>::iterator,
+                  std::unordered_multimap<uint64_t, int64_t>::iterator> range = byEmail.equal_range(profileEmailHash(email));
+        int64_t best = -1;
+        Profile p;
+        for (std::unordered_multimap<uint64_t, int64_t>::iterator it = range.first; it != range.second; ++it) {
+            if (it->second > best && readRecord(it->second, p) && p.email == email) best = it->second;
+        }
+        return best;
+    }
+
+public:
+    ProfileStore() : data(nullptr), index(nullptr), end(0) {}
+
+    ~ProfileStore() {
+        close();
+    }
+
+    //opens or creates base.dat and base.pidx
+    bool open(const char* base) {
+        close();
+        dataPath = std::string(base) + ".dat";
+        indexPath = std::string(base) + ".pidx";
+
+        data = fopen(dataPath.c_str(), "r+b");
+        if (!data) {
+            data = fopen(dataPath.c_str(), "w+b");
+            if (!data) return false;
+            ProfileFileHeader fh;
+            memcpy(fh.magic, "PROFILES", 8);
+            fh.version = PROFILE_STORE_VERSION;
+            fh.pad = 0;
+            fwrite(&fh, sizeof(fh), 1, data);
+            fflush(data);
+            remove(indexPath.c_str());
+        }
+        ProfileFileHeader fh;
+        if (!seek(data, 0) || fread(&fh, sizeof(fh), 1, data) != 1 || memcmp(fh.magic, "PROFILES", 8) != 0 ||
+            fh.version != PROFILE_STORE_VERSION) {
+            close();
+            return false;
+        }
+
+        //the index up to the last record it covers, then the segment after it.
+        //under the lock, so a kiosk starting cannot reset it under another's append
+        lock(true);
+        end = sizeof(ProfileFileHeader);
+        FILE* in = fopen(indexPath.c_str(), "rb");
+        if (in) {
+            ProfileIndexEntry e;
+            int64_t last = -1;
+            while (fread(&e, sizeof(e), 1, in) == 1) {
+                byEmail.insert(std::make_pair(e.emailHash, e.offset));
+                if (e.offset > last) last = e.offset;
+            }
+            fclose(in);
+            Profile p;
+            int64_t next;
+            if (last >= 0 && readRecord(last, p, &next)) {
+                end = next;
+            } else {
+                byEmail.clear();
+            }
+        }
+        index = fopen(indexPath.c_str(), byEmail.empty() ? "w+b" : "a+b");
+        lock(false);
+        catchUp();
+        return true;
+    }
+
+    //writes what is still queued
+    void close() {
+        if (data) flush();
+        if (data) fclose(data);
+        if (index) fclose(index);
+        data = index = nullptr;
+        byEmail.clear();
+        pending.clear();
+        end = 0;
+    }
+
+    //queues a new or changed profile; visible to get() at once. false for an
+    //email too long to store, which would be cut short and never found again
+    bool put(const Profile& p) {
+        if (p.email.size() > PROFILE_MAX_EMAIL) return false;
+        pending.push_back(p);
+        if (pending.size() >= 64) flush();
+        return true;
+    }
+
+    //writes every queued profile in one locked append
+    bool flush() {
+        if (!data || pending.empty()) return true;
+        std::string batch;
+        std::vector<std::pair<std::string, int64_t> > written;
+        lock(true);
+        catchUp();
+        int64_t offset = end;
+        for (size_t i = 0; i < pending.size(); i++) {
+            const Profile& p = pending[i];
+            std::string email = p.email, name = p.name.substr(0, 255);
+            ProfileRecordHeader h;
+            memset(&h, 0, sizeof(h));
+            h.magic = PROFILE_RECORD_MAGIC;
+            h.customerId = p.customerId;
+            h.memberSince = (int64_t)p.memberSince;
+            h.emailLength = (uint8_t)email.size();
+            h.nameLength = (uint8_t)name.size();
+            std::string strings = email + name;
+            h.check = profileRecordCheck(h, strings.data(), strings.size());
+            batch.append((const char*)&h, sizeof(h));
+            batch.append(strings);
+            written.push_back(std::make_pair(email, offset));
+            offset += (int64_t)(sizeof(h) + strings.size());
+        }
+        bool ok = seek(data, end) && fwrite(batch.data(), 1, batch.size(), data) == batch.size();
+        fflush(data);
+        if (ok) {
+            for (size_t i = 0; i < written.size(); i++) remember(written[i].first, written[i].second);
+            end = offset;
+            pending.clear();
+        }
+        indexTail();
+        lock(false);
+        return ok;
+    }
+
+    //one hash lookup and one seek
+    bool get(const std::string& email, Profile& out) {
+        for (size_t i = pending.size(); i-- > 0;) {
+            if (pending[i].email == email) {
+                out = pending[i];
+                return true;
+            }
+        }
+        if (!data) return false;
+        int64_t offset = locate(email);
+        if (offset < 0) {
+            catchUp();   //perhaps just registered at another kiosk
+            offset = locate(email);
+        }
+        return offset >= 0 && readRecord(offset, out);
+    }
+
+    //the newest record of every profile, in first-registered order
+    template <typename F>
+    void scan(F visit) {
+        flush();
+        catchUp();
+        std::vector<Profile> latest;
+        std::unordered_map<std::string, size_t> slot;
+        Profile p;
+        int64_t next;
+        for (int64_t offset = sizeof(ProfileFileHeader); readRecord(offset, p, &next); offset = next) {
+            std::unordered_map<std::string, size_t>::iterator it = slot.find(p.email);
+            if (it == slot.end()) {
+                slot[p.email] = latest.size();
+                latest.push_back(p);
+            } else {
+                latest[it->second] = p;
+            }
+        }
+        for (size_t i = 0; i < latest.size(); i++) visit(latest[i]);
+    }
+
+    size_t size() const { return byEmail.size(); }
+    bool isOpen() const { return data != nullptr; }
+};
+
+//the old per-customer text form
+inline bool writeProfileFile(const std::string& path, const Profile& p) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "Customer ID: %d\nName: %s\nEmail: %s\n", p.customerId, p.name.c_str(), p.email.c_str());
+    return fclose(f) == 0;
+}
+
+inline bool readProfileFile(const std::string& path, Profile& p) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char line[512];
+    int fields = 0;
+    p.customerId = 0;
+    p.memberSince = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "Customer ID: ", 13) == 0) {
+            p.customerId = atoi(line + 13);
+            fields++;
+        } else if (strncmp(line, "Name: ", 6) == 0) {
+            p.name = line + 6;
+            fields++;
+        } else if (strncmp(line, "Email: ", 7) == 0) {
+            p.email = line + 7;
+            fields++;
+        }
+    }
+    fclose(f);
+    return fields == 3 && !p.email.empty();
+}
+
+//names of the <email>.txt files in dir
+inline std::vector<std::string> listProfileFiles(const std::string& dir) {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE h = FindFirstFileA((dir + "\\*@*.txt").c_str(), &found);
+    if (h == INVALID_HANDLE_VALUE) return names;
+    do {
+        names.push_back(found.cFileName);
+    } while (FindNextFileA(h, &found));
+    FindClose(h);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.find('@') != std::string::npos && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".txt") == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+#endif
+    return names;
+}
+
+//imports every <email>.txt profile in dir and removes the file once it is
+//stored; fix(profile) may correct a profile first. returns the number imported
+template <typename F>
+int migrateProfileFiles(ProfileStore& store, const std::string& dir, F fix) {
+    std::vector<std::string> names = listProfileFiles(dir);
+    std::vector<std::string> imported;
+    for (size_t i = 0; i < names.size(); i++) {
+        Profile p;
+        std::string path = dir + "/" + names[i];
+        if (!readProfileFile(path, p) || names[i] != p.email + ".txt") continue;
+        Profile existing;
+        if (store.get(p.email, existing)) p.memberSince = existing.memberSince;
+        fix(p);
+        if (store.put(p)) imported.push_back(path);
+    }
+    if (!store.flush()) return 0;
+    for (size_t i = 0; i < imported.size(); i++) remove(imported[i].c_str());
+    return (int)imported.size();
+}
+
+//writes every profile to dir as <email>.txt; returns the number written
+inline int exportProfileFiles(ProfileStore& store, const std::string& dir) {
+    int written = 0;
+    store.scan([&](const Profile& p) {
+        if (writeProfileFile(dir + "/" + p.email + ".txt", p)) written++;
+    });
+    return written;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef SALES_AGGREGATES_H
+#define SALES_AGGREGATES_H
+
+//running sales totals, kept up to date as orders are written so reports do
+//not rescan the log. the totals are a fold over order_history.log up to
+//logEnd; they are checkpointed to order_history.agg (written beside it under
+//a name of the writing process and thread, and renamed into place) and anything the checkpoint does not cover is folded in
+//from the log tail when it is loaded. any kiosk may save: each checkpoint is
+//a complete fold of some prefix of the log, so an older one only means a
+//longer catch-up next time.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <functional>
+#include "money.h"
+#include "order_log.h"
+#include "sales_analytics.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+const uint32_t SALES_AGG_VERSION = 1;
+
+struct SalesAggHeader {
+    char magic[8];          //"SALESAGG"
+    uint32_t version;
+    uint32_t hourCount;     //always 24
+    int64_t logEnd;
+    int64_t orders;
+    int64_t units;
+    int64_t revenue;
+    int32_t dayCount;
+    int32_t drinkCount;
+    int32_t customerCount;
+    uint32_t pad;
+};
+
+//one row of a table in the checkpoint; drinks are followed by the name bytes
+struct SalesAggRow {
+    int64_t key;            //local day number, customer id, or name length
+    int64_t revenue;
+    int64_t units;
+};
+
+class SalesAggregates {
+private:
+    int64_t tzOffset;
+
+public:
+    int64_t logEnd;                          //log offset the totals cover up to
+    int64_t orders;
+    SalesTotals total;
+    SalesTotals byHour[24];                  //local hour of day
+    std::map<int64_t, SalesTotals> byDay;    //local days since 1970
+    std::map<std::string, SalesTotals> byDrink;
+    std::map<int, SalesTotals> byCustomer;   //revenue and cups
+
+    SalesAggregates() : tzOffset(localTimeOffset()) {
+        reset();
+    }
+
+    void reset() {
+        logEnd = 0;
+        orders = 0;
+        total = SalesTotals();
+        for (int h = 0; h < 24; h++) byHour[h] = SalesTotals();
+        byDay.clear();
+        byDrink.clear();
+        byCustomer.clear();
+    }
+
+    //cups per order
+    double averageBasket() const {
+        return orders ? (double)total.units / orders : 0;
+    }
+
+    int64_t dayOf(time_t placed) const {
+        int64_t local = (int64_t)placed + tzOffset;
+        return local >= 0 ? local / 86400 : (local - 86399) / 86400;
+    }
+
+    //"YYYY-MM-DD" for a day number from byDay
+    static std::string dayText(int64_t day) {
+        time_t t = (time_t)(day * 86400);
+        struct tm d = *gmtime(&t);
+        char buf[16];
+        strftime(buf, sizeof(buf), "%Y-%m-%d", &d);
+        return buf;
+    }
+
+    void add(const OrderLogRecord& r) {
+        orders++;
+        total.add(r.total, r.itemCount);
+        int64_t local = (int64_t)r.placed + tzOffset;
+        byHour[((local % 86400 + 86400) % 86400) / 3600].add(r.total, r.itemCount);
+        byDay[dayOf(r.placed)].add(r.total, r.itemCount);
+        byCustomer[r.customerId].add(r.total, r.itemCount);
+        for (size_t i = 0; i < r.items.size(); i++) {
+            byDrink[r.items[i].name].add(r.items[i].lineCents, r.items[i].quantity);
+        }
+    }
+
+    //folds in every record past logEnd; starts over if the log is shorter
+    //than the checkpoint (replaced or truncated). returns the records added
+    int catchUp(OrderLog& log) {
+        int added = 0;
+        if (!log.isOpen()) return 0;
+        auto fold = [&](const OrderLogRecord& r) {
+            add(r);
+            added++;
+            return true;
+        };
+        log.scan(fold, logEnd);
+        if (logEnd > log.validEnd()) {
+            reset();
+            log.scan(fold);
+        }
+        logEnd = log.validEnd();
+        return added;
+    }
+
+    //false (and empty totals) when there is no usable checkpoint
+    bool load(const char* path) {
+        reset();
+        FILE* f = fopen(path, "rb");
+        if (!f) return false;
+        SalesAggHeader h;
+        SalesAggRow row;
+        bool ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, "SALESAGG", 8) == 0 &&
+                  h.version == SALES_AGG_VERSION && h.hourCount == 24;
+        for (int i = 0; ok && i < 24; i++) {
+            ok = fread(&row, sizeof(row), 1, f) == 1;
+            byHour[i].add(row.revenue, row.units);
+        }
+        for (int i = 0; ok && i < h.dayCount; i++) {
+            ok = fread(&row, sizeof(row), 1, f) == 1;
+            if (ok) byDay[row.key].add(row.revenue, row.units);
+        }
+        for (int i = 0; ok && i < h.drinkCount; i++) {
+            char name[256];
+            ok = fread(&row, sizeof(row), 1, f) == 1 && row.key >= 0 && row.key < 256 &&
+                 fread(name, 1, (size_t)row.key, f) == (size_t)row.key;
+            if (ok) byDrink[std::string(name, (size_t)row.key)].add(row.revenue, row.units);
+        }
+        for (int i = 0; ok && i < h.customerCount; i++) {
+            ok = fread(&row, sizeof(row), 1, f) == 1;
+            if (ok) byCustomer[(int)row.key].add(row.revenue, row.units);
+        }
+        fclose(f);
+        if (!ok) {
+            reset();
+            return false;
+        }
+        logEnd = h.logEnd;
+        orders = h.orders;
+        total.add(h.revenue, h.units);
+        return true;
+    }
+
+    bool save(const char* path) const {
+        std::string image;
+        SalesAggHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, "SALESAGG", 8);
+        h.version = SALES_AGG_VERSION;
+        h.hourCount = 24;
+        h.logEnd = logEnd;
+        h.orders = orders;
+        h.units = total.units;
+        h.revenue = total.revenue;
+        h.dayCount = (int32_t)byDay.size();
+        h.drinkCount = (int32_t)byDrink.size();
+        h.customerCount = (int32_t)byCustomer.size();
+        image.append((const char*)&h, sizeof(h));
+
+        SalesAggRow row;
+        for (int i = 0; i < 24; i++) {
+            row.key = i;
+            row.revenue = byHour[i].revenue;
+            row.units = byHour[i].units;
+            image.append((const char*)&row, sizeof(row));
+        }
+        for (std::map<int64_t, SalesTotals>::const_iterator it = byDay.begin(); it != byDay.end(); ++it) {
+            row.key = it->first;
+            row.revenue = it->second.revenue;
+            row.units = it->second.units;
+            image.append((const char*)&row, sizeof(row));
+        }
+        for (std::map<std::string, SalesTotals>::const_iterator it = byDrink.begin(); it != byDrink.end(); ++it) {
+            std::string name = it->first.substr(0, 255);
+            row.key = (int64_t)name.size();
+            row.revenue = it->second.revenue;
+            row.units = it->second.units;
+            image.append((const char*)&row, sizeof(row));
+            image.append(name);
+        }
+        for (std::map<int, SalesTotals>::const_iterator it = byCustomer.begin(); it != byCustomer.end(); ++it) {
+            row.key = it->first;
+            row.revenue = it->second.revenue;
+            row.units = it->second.units;
+            image.append((const char*)&row, sizeof(row));
+        }
+
+        //kiosks and the admin program save at the same time, each to its own file
+#ifdef _WIN32
+        unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+        unsigned long pid = (unsigned long)getpid();
+#endif
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), ".%lu.%lx.tmp", pid,
+                 (unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::string tmpPath = std::string(path) + suffix;
+        FILE* out = fopen(tmpPath.c_str(), "wb");
+        if (!out) return false;
+        bool ok = fwrite(image.data(), 1, image.size(), out) == image.size();
+        ok = (fclose(out) == 0) && ok;
+#ifdef _WIN32
+        ok = ok && MoveFileExA(tmpPath.c_str(), path, MOVEFILE_REPLACE_EXISTING);
+#else
+        ok = ok && rename(tmpPath.c_str(), path) == 0;
+#endif
+        if (!ok) remove(tmpPath.c_str());
+        return ok;
+    }
+};
+
+#endif
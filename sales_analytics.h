@@ -0,0 +1,281 @@
+#ifndef SALES_ANALYTICS_H
+#define SALES_ANALYTICS_H
+
+//sales totals over the whole order log (order_log.h) in one parallel pass.
+//the log is mapped, cut into one slice per thread, and each slice starts at
+//the first valid record at or after its cut, found by the record magic and
+//confirmed by the checksum. items are read in place, no record is copied out
+//of the mapping: menu drinks count into per-thread vectors by slot, anything
+//else is keyed by a string_view into the mapping until the per-thread tables
+//are merged at the end.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include "money.h"
+#include "order_log.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct SalesTotals {
+    Cents revenue;
+    int64_t units;
+
+    SalesTotals() : revenue(0), units(0) {}
+
+    void add(Cents r, int64_t u) {
+        revenue += r;
+        units += u;
+    }
+};
+
+//the menu the scan totals against. every drink gets a dense slot so the hot
+//loop counts into a vector; ids index a flat table, items imported from text
+//(drink id 0) are matched by name
+class SalesCatalog {
+private:
+    std::deque<std::string> storage;   //stable storage for the name keys
+    std::unordered_map<std::string_view, int> byName;
+
+public:
+    std::vector<std::string> categories;
+    std::vector<std::string_view> names;   //by slot
+    std::vector<int> categoryOfSlot;
+    std::vector<int> slotById;             //-1 for ids not on the menu
+
+    void add(int id, const char* name, const char* category) {
+        int cat = -1;
+        for (size_t i = 0; i < categories.size(); i++) {
+            if (categories[i] == category) cat = (int)i;
+        }
+        if (cat == -1) {
+            categories.push_back(category);
+            cat = (int)categories.size() - 1;
+        }
+        int slot = (int)names.size();
+        storage.push_back(name);
+        names.push_back(storage.back());
+        categoryOfSlot.push_back(cat);
+        byName[storage.back()] = slot;
+        if (id > 0 && id < (1 << 20)) {
+            if ((size_t)id >= slotById.size()) slotById.resize(id + 1, -1);
+            slotById[id] = slot;
+        }
+    }
+
+    //-1 when the drink is not on the menu any more
+    int slotOf(int id, std::string_view name) const {
+        if (id > 0 && (size_t)id < slotById.size() && slotById[id] != -1) return slotById[id];
+        std::unordered_map<std::string_view, int>::const_iterator it = byName.find(name);
+        return it == byName.end() ? -1 : it->second;
+    }
+};
+
+struct SalesReport {
+    int64_t orders;
+    int64_t bytes;           //size of the log scanned
+    int threads;
+    double seconds;          //scan and merge, not the mapping
+    SalesTotals total;
+    std::map<std::string, SalesTotals> byDrink;
+    std::vector<SalesTotals> byCategory;   //catalog order, one more for unknown drinks
+    SalesTotals byHour[24];                //local time the order was placed
+    SalesTotals byCustom[4][4];            //[ice][sweet], 1 regular 2 less 3 none
+    std::map<int, SalesTotals> byCustomer; //orders: revenue and item count
+
+    SalesReport() : orders(0), bytes(0), threads(0), seconds(0) {}
+
+    double gigabytesPerSecond() const {
+        return seconds > 0 ? bytes / seconds / 1e9 : 0;
+    }
+};
+
+//what one thread gathers over its slice
+struct SalesPartial {
+    int64_t orders;
+    SalesTotals total;
+    std::vector<SalesTotals> bySlot;                              //menu drinks
+    std::unordered_map<std::string_view, SalesTotals> offMenu;   //the rest, by name
+    std::vector<SalesTotals> byCategory;
+    SalesTotals byHour[24];
+    SalesTotals byCustom[4][4];
+    std::unordered_map<int, SalesTotals> byCustomer;
+
+    SalesPartial() : orders(0) {}
+};
+
+//seconds to add to a time_t for local wall-clock time; taken once, so a
+//scan across a daylight saving change is off by an hour on one side of it
+inline int64_t localTimeOffset() {
+    time_t now = time(0);
+    struct tm local = *localtime(&now);
+    struct tm utc = *gmtime(&now);
+    local.tm_isdst = 0;
+    utc.tm_isdst = 0;
+    return (int64_t)difftime(mktime(&local), mktime(&utc));
+}
+
+//offset of the first valid record starting in [from, limit), or limit
+inline size_t findOrderRecord(const char* base, size_t size, size_t from, size_t limit) {
+    const unsigned char first = (unsigned char)(ORDER_RECORD_MAGIC & 0xFF);
+    for (size_t pos = from; pos < limit && pos + sizeof(OrderRecordHeader) <= size; pos++) {
+        const void* hit = memchr(base + pos, first, limit - pos);
+        if (!hit) break;
+        pos = (const char*)hit - base;
+        if (pos + sizeof(OrderRecordHeader) > size) break;
+        OrderRecordHeader h;
+        memcpy(&h, base + pos, sizeof(h));
+        if (h.magic == ORDER_RECORD_MAGIC && pos + sizeof(h) + h.itemsLength <= size &&
+            h.check == orderRecordCheck(h, base + pos + sizeof(h), h.itemsLength)) {
+            return pos;
+        }
+    }
+    return limit;
+}
+
+//every record that starts in [begin, end)
+inline void scanOrderSlice(const char* base, size_t size, size_t begin, size_t end,
+                           const SalesCatalog& catalog, int64_t tzOffset, SalesPartial& out) {
+    out.bySlot.assign(catalog.names.size(), SalesTotals());
+    out.byCategory.assign(catalog.categories.size() + 1, SalesTotals());
+    size_t pos = findOrderRecord(base, size, begin, end);
+    while (pos < end) {
+        OrderRecordHeader h;
+        memcpy(&h, base + pos, sizeof(h));
+        size_t next = pos + sizeof(h) + h.itemsLength;
+        if (h.magic != ORDER_RECORD_MAGIC || next > size) {
+            pos = findOrderRecord(base, size, pos + 1, end);   //skip a damaged stretch
+            continue;
+        }
+
+        out.orders++;
+        out.total.add(h.totalCents, h.itemCount);
+        out.byCustomer[h.customerId].add(h.totalCents, h.itemCount);
+        int64_t secondOfDay = ((h.placed + tzOffset) % 86400 + 86400) % 86400;
+        out.byHour[secondOfDay / 3600].add(h.totalCents, h.itemCount);
+
+        const char* p = base + pos + sizeof(h);
+        const char* itemsEnd = p + h.itemsLength;
+        while (p + sizeof(OrderItemHeader) <= itemsEnd) {
+            OrderItemHeader item;
+            memcpy(&item, p, sizeof(item));
+            p += sizeof(item);
+            if (p + item.nameLength > itemsEnd) break;
+            std::string_view name(p, item.nameLength);
+            p += item.nameLength;
+
+            int slot = catalog.slotOf(item.drinkId, name);
+            if (slot == -1) {
+                out.offMenu[name].add(item.lineCents, item.quantity);
+                out.byCategory.back().add(item.lineCents, item.quantity);
+            } else {
+                out.bySlot[slot].add(item.lineCents, item.quantity);
+                out.byCategory[catalog.categoryOfSlot[slot]].add(item.lineCents, item.quantity);
+            }
+            out.byCustom[item.ice & 3][item.sweet & 3].add(item.lineCents, item.quantity);
+        }
+        pos = next;
+    }
+}
+
+//maps path and totals it on the given number of threads (0 = every core)
+inline bool analyzeOrderLog(const char* path, const SalesCatalog& catalog, int threads, SalesReport& report) {
+    const char* base = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER length;
+    GetFileSizeEx(file, &length);
+    size = (size_t)length.QuadPart;
+    HANDLE mapping = size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    base = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 && st.st_size > 0) {
+        size = (size_t)st.st_size;
+        void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+        base = (p == MAP_FAILED) ? nullptr : (const char*)p;
+        if (base) madvise(p, size, MADV_SEQUENTIAL);
+    }
+    fclose(f);  //the mapping stays valid after the file is closed
+#endif
+
+    bool ok = base && size >= sizeof(OrderLogFileHeader) && memcmp(base, "ORDERLOG", 8) == 0;
+    if (ok) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        //slices smaller than 1 MB are not worth a thread
+        size_t body = size - sizeof(OrderLogFileHeader);
+        if ((size_t)threads > body / (1 << 20) + 1) threads = (int)(body / (1 << 20) + 1);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int64_t tz = localTimeOffset();
+        std::vector<SalesPartial> parts(threads);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            size_t from = sizeof(OrderLogFileHeader) + body * t / threads;
+            size_t to = sizeof(OrderLogFileHeader) + body * (t + 1) / threads;
+            workers.push_back(std::thread(scanOrderSlice, base, size, from, to, std::cref(catalog), tz,
+                                          std::ref(parts[t])));
+        }
+        for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+        report = SalesReport();
+        report.bytes = (int64_t)size;
+        report.threads = threads;
+        report.byCategory.assign(catalog.categories.size() + 1, SalesTotals());
+        for (int t = 0; t < threads; t++) {
+            const SalesPartial& p = parts[t];
+            report.orders += p.orders;
+            report.total.add(p.total.revenue, p.total.units);
+            for (size_t s = 0; s < p.bySlot.size(); s++) {
+                if (p.bySlot[s].units == 0) continue;
+                report.byDrink[std::string(catalog.names[s])].add(p.bySlot[s].revenue, p.bySlot[s].units);
+            }
+            for (std::unordered_map<std::string_view, SalesTotals>::const_iterator it = p.offMenu.begin();
+                 it != p.offMenu.end(); ++it) {
+                report.byDrink[std::string(it->first)].add(it->second.revenue, it->second.units);
+            }
+            for (size_t c = 0; c < p.byCategory.size(); c++) {
+                report.byCategory[c].add(p.byCategory[c].revenue, p.byCategory[c].units);
+            }
+            for (int h = 0; h < 24; h++) report.byHour[h].add(p.byHour[h].revenue, p.byHour[h].units);
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) report.byCustom[i][j].add(p.byCustom[i][j].revenue, p.byCustom[i][j].units);
+            }
+            for (std::unordered_map<int, SalesTotals>::const_iterator it = p.byCustomer.begin();
+                 it != p.byCustomer.end(); ++it) {
+                report.byCustomer[it->first].add(it->second.revenue, it->second.units);
+            }
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    if (base) munmap((void*)base, size);
+#endif
+    return ok;
+}
+
+#endif
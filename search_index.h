@@ -0,0 +1,305 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SEARCH_INDEX_SSE2 1
+#endif
+
+//case-insensitive compare of n bytes (ASCII), 16 bytes per step where SSE2 is available
+inline bool ciEqual(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+#ifdef SEARCH_INDEX_SSE2
+    const __m128i upperLo = _mm_set1_epi8('A' - 1);
+    const __m128i upperHi = _mm_set1_epi8('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        //set the case bit only on 'A'..'Z'
+        __m128i ua = _mm_and_si128(_mm_cmpgt_epi8(va, upperLo), _mm_cmplt_epi8(va, upperHi));
+        __m128i ub = _mm_and_si128(_mm_cmpgt_epi8(vb, upperLo), _mm_cmplt_epi8(vb, upperHi));
+        va = _mm_or_si128(va, _mm_and_si128(ua, caseBit));
+        vb = _mm_or_si128(vb, _mm_and_si128(ub, caseBit));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i < n; i++) {
+        char ca = a[i], cb = b[i];
+        if (ca >= 'A' && ca <= 'Z') ca += 32;
+        if (cb >= 'A' && cb <= 'Z') cb += 32;
+        if (ca != cb) return false;
+    }
+    return true;
+}
+
+//case-insensitive substring search, returns the offset or -1
+inline int ciFind(const char* text, size_t textLen, const char* needle, size_t needleLen) {
+    if (needleLen == 0) return 0;
+    if (needleLen > textLen) return -1;
+
+    char first = needle[0];
+    char lower = (first >= 'A' && first <= 'Z') ? first + 32 : first;
+    char upper = (lower >= 'a' && lower <= 'z') ? lower - 32 : lower;
+    size_t last = textLen - needleLen;
+    size_t i = 0;
+#ifdef SEARCH_INDEX_SSE2
+    //scan 16 candidate start positions at a time for the first character
+    const __m128i vl = _mm_set1_epi8(lower);
+    const __m128i vu = _mm_set1_epi8(upper);
+    for (; i + 16 <= last + 1; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(text + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, vl), _mm_cmpeq_epi8(block, vu)));
+        while (mask) {
+            int bit = 0;
+            while (!(mask & (1 << bit))) bit++;
+            if (ciEqual(text + i + bit, needle, needleLen)) return (int)(i + bit);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= last; i++) {
+        if ((text[i] == lower || text[i] == upper) && ciEqual(text + i, needle, needleLen)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+struct SearchHit {
+    int key;
+    int score;  //lower is better: 0 exact, 1 prefix, 2 word prefix, 3 substring, 10+ typo
+};
+
+//trigram index over one or more text fields per key. queries shorter than a
+//trigram are matched by a scan of the entries, as a substring may start
+//anywhere. entries are added, replaced and removed incrementally.
+class SearchIndex {
+private:
+    struct Doc {
+        int key;
+        std::string text;  //fields joined with '\x1f', original case
+        bool live;
+    };
+
+    std::vector<Doc> docs;
+    std::unordered_map<int, int> slotByKey;
+    std::unordered_map<uint32_t, std::vector<int>> postings;
+    int deadCount;
+    std::vector<unsigned short> hitCount;  //scratch, one counter per slot
+    std::vector<int> touched;
+
+    static char lowerChar(char c) {
+        return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+    }
+
+    //grams are tagged by kind in the top byte so they share one table
+    static uint32_t trigram(const char* p) {
+        return (3u << 24) | ((uint32_t)(unsigned char)lowerChar(p[0]) << 16) |
+               ((uint32_t)(unsigned char)lowerChar(p[1]) << 8) | (unsigned char)lowerChar(p[2]);
+    }
+
+    static bool isWordStart(const std::string& t, size_t i) {
+        if (i == 0) return true;
+        char prev = t[i - 1];
+        if (prev == '\x1f' || prev == ' ' || prev == '.' || prev == '@' || prev == '_') return true;
+        //camel case names like "BrownSugarPearl"
+        return (t[i] >= 'A' && t[i] <= 'Z') && (prev >= 'a' && prev <= 'z');
+    }
+
+    template <typename F>
+    static void forEachGram(const std::string& t, F emit) {
+        for (size_t i = 0; i < t.size(); i++) {
+            if (t[i] == '\x1f') continue;
+            if (i + 3 <= t.size() && t[i + 1] != '\x1f' && t[i + 2] != '\x1f') {
+                emit(trigram(&t[i]));
+            }
+        }
+    }
+
+    //smallest edit distance between q and any substring of t (q, t lowercase-compared)
+    static int substringDistance(const std::string& q, const std::string& t, int limit) {
+        std::vector<int> prev(q.size() + 1), cur(q.size() + 1);
+        for (size_t j = 0; j <= q.size(); j++) prev[j] = (int)j;
+        int best = prev[q.size()];
+        for (size_t i = 1; i <= t.size(); i++) {
+            cur[0] = 0;  //a match may start anywhere in t
+            char tc = lowerChar(t[i - 1]);
+            for (size_t j = 1; j <= q.size(); j++) {
+                int cost = (lowerChar(q[j - 1]) == tc) ? 0 : 1;
+                cur[j] = (std::min)((std::min)(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + cost);
+            }
+            best = (std::min)(best, cur[q.size()]);
+            if (best == 0) break;
+            prev.swap(cur);
+        }
+        return best <= limit ? best : limit + 1;
+    }
+
+    //best score over all fields and occurrences, -1 if q is not a substring
+    int scoreMatch(const Doc& d, const std::string& q) const {
+        int best = -1;
+        size_t fieldStart = 0;
+        while (fieldStart <= d.text.size()) {
+            size_t fieldEnd = d.text.find('\x1f', fieldStart);
+            if (fieldEnd == std::string::npos) fieldEnd = d.text.size();
+            size_t len = fieldEnd - fieldStart;
+
+            size_t from = 0;
+            while (from < len) {
+                int pos = ciFind(d.text.data() + fieldStart + from, len - from, q.data(), q.size());
+                if (pos < 0) break;
+                size_t at = from + pos;
+                int score = 3;
+                if (at == 0) score = (q.size() == len) ? 0 : 1;
+                else if (isWordStart(d.text, fieldStart + at)) score = 2;
+                if (best < 0 || score < best) best = score;
+                if (score <= 2) break;
+                from = at + 1;
+            }
+            fieldStart = fieldEnd + 1;
+        }
+        return best;
+    }
+
+    //best score first, then by key; cut to maxResults
+    static void rankHits(std::vector<SearchHit>& hits, int maxResults) {
+        std::sort(hits.begin(), hits.end(), [](const SearchHit& a, const SearchHit& b) {
+            if (a.score != b.score) return a.score < b.score;
+            return a.key < b.key;
+        });
+        if ((int)hits.size() > maxResults) hits.resize(maxResults);
+    }
+
+    void addPostings(int slot) {
+        forEachGram(docs[slot].text, [&](uint32_t g) {
+            std::vector<int>& list = postings[g];
+            //a gram repeated inside one entry is posted once
+            if (list.empty() || list.back() != slot) list.push_back(slot);
+        });
+    }
+
+    void compact() {
+        std::vector<Doc> live;
+        for (size_t i = 0; i < docs.size(); i++) {
+            if (docs[i].live) live.push_back(docs[i]);
+        }
+        docs.swap(live);
+        postings.clear();
+        slotByKey.clear();
+        deadCount = 0;
+        for (int i = 0; i < (int)docs.size(); i++) {
+            slotByKey[docs[i].key] = i;
+            addPostings(i);
+        }
+    }
+
+public:
+    SearchIndex() : deadCount(0) {}
+
+    void clear() {
+        docs.clear();
+        slotByKey.clear();
+        postings.clear();
+        deadCount = 0;
+    }
+
+    int size() const { return (int)slotByKey.size(); }
+
+    //adds or replaces the searchable fields of key
+    void put(int key, const std::vector<std::string>& fields) {
+        remove(key);
+        Doc d;
+        d.key = key;
+        d.live = true;
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (i) d.text += '\x1f';
+            d.text += fields[i];
+        }
+        int slot = (int)docs.size();
+        docs.push_back(d);
+        slotByKey[key] = slot;
+        addPostings(slot);
+    }
+
+    void remove(int key) {
+        std::unordered_map<int, int>::iterator it = slotByKey.find(key);
+        if (it == slotByKey.end()) return;
+        docs[it->second].live = false;
+        slotByKey.erase(it);
+        //stale slots are skipped at query time, rebuild once they pile up
+        if (++deadCount > 64 && deadCount * 2 > (int)docs.size()) compact();
+    }
+
+    //ranked matches: substrings first, then entries within a small edit distance
+    std::vector<SearchHit> search(const std::string& query, int maxResults = 50) {
+        std::vector<SearchHit> hits;
+        std::string q = query;
+        if (q.empty()) return hits;
+
+        if (q.size() < 3) {
+            for (size_t slot = 0; slot < docs.size(); slot++) {
+                if (!docs[slot].live) continue;
+                SearchHit h;
+                h.key = docs[slot].key;
+                h.score = scoreMatch(docs[slot], q);
+                if (h.score >= 0) hits.push_back(h);
+            }
+            rankHits(hits, maxResults);
+            return hits;
+        }
+
+        std::vector<uint32_t> grams;
+        for (size_t i = 0; i + 3 <= q.size(); i++) grams.push_back(trigram(&q[i]));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+        int maxEdits = q.size() >= 8 ? 2 : (q.size() >= 4 ? 1 : 0);
+        //each edit can destroy up to three trigrams
+        int need = (int)grams.size() - 3 * maxEdits;
+        if (need < 1) need = 1;
+
+        hitCount.resize(docs.size(), 0);
+        touched.clear();
+        for (size_t g = 0; g < grams.size(); g++) {
+            std::unordered_map<uint32_t, std::vector<int>>::const_iterator it = postings.find(grams[g]);
+            if (it == postings.end()) continue;
+            const std::vector<int>& list = it->second;
+            for (size_t k = 0; k < list.size(); k++) {
+                if (hitCount[list[k]]++ == 0) touched.push_back(list[k]);
+            }
+        }
+
+        for (size_t k = 0; k < touched.size(); k++) {
+            int slot = touched[k];
+            int count = hitCount[slot];
+            hitCount[slot] = 0;
+            const Doc& d = docs[slot];
+            if (!d.live || count < need) continue;
+
+            int score = -1;
+            if (count == (int)grams.size()) score = scoreMatch(d, q);
+            if (score < 0 && maxEdits > 0) {
+                int dist = substringDistance(q, d.text, maxEdits);
+                if (dist <= maxEdits) score = 10 + dist;
+            }
+            if (score >= 0) {
+                SearchHit h;
+                h.key = d.key;
+                h.score = score;
+                hits.push_back(h);
+            }
+        }
+
+        rankHits(hits, maxResults);
+        return hits;
+    }
+};
+
+#endif
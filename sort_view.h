@@ -0,0 +1,65 @@
+#ifndef SORT_VIEW_H
+#define SORT_VIEW_H
+
+#include <vector>
+#include <algorithm>
+
+//sorted view over a record array, kept as a permutation of indices.
+//records are never moved; the order is rebuilt only when the keys change
+//or the caller reports a new data version.
+template <typename T>
+class SortView {
+public:
+    //returns <0, 0 or >0 like strcmp
+    typedef int (*KeyCompare)(const T& a, const T& b);
+
+private:
+    std::vector<KeyCompare> keys;
+    std::vector<int> order;
+    unsigned long builtVersion;
+    const T* builtRecords;
+    bool valid;
+
+    void rebuild(const T* records, int count) {
+        order.resize(count);
+        for (int i = 0; i < count; i++) {
+            order[i] = i;
+        }
+
+        //stable, so equal records keep their storage order
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            for (size_t k = 0; k < keys.size(); k++) {
+                int cmp = keys[k](records[a], records[b]);
+                if (cmp != 0) return cmp < 0;
+            }
+            return false;
+        });
+    }
+
+public:
+    SortView() : builtVersion(0), builtRecords(nullptr), valid(false) {}
+
+    //sets the sort keys, most significant first
+    void setKeys(const std::vector<KeyCompare>& newKeys) {
+        keys = newKeys;
+        valid = false;
+    }
+
+    void invalidate() {
+        valid = false;
+    }
+
+    //index order for records[0..count); cached until version or keys change
+    const std::vector<int>& get(const T* records, int count, unsigned long version) {
+        if (!valid || version != builtVersion || records != builtRecords ||
+            count != (int)order.size()) {
+            rebuild(records, count);
+            builtVersion = version;
+            builtRecords = records;
+            valid = true;
+        }
+        return order;
+    }
+};
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef TABLE_JOURNAL_H
+#define TABLE_JOURNAL_H
+
+//edits to the csv tables (mixue.txt, customers.txt) without rewriting them.
+//each file stays the compacted base; changes go to base.journal as small
+//records: put (a whole row, replacing the row with the same key or added at
+//the end) and erase (a key). the key is the first column. readers apply the
+//journal on top of the base. compaction writes base + journal to a temp file,
+//renames it over the base and empties the journal. replaying a journal that
+//is already in the base changes nothing, so a crash between the rename and
+//emptying the journal is harmless. a torn last record fails its checksum and
+//readers stop there; a writer that finds one compacts before appending, so
+//nothing is written behind it. writers, compaction and readers take
+//base.lock, so no reader sees a new base with an old journal missing and no
+//record is lost to a compaction running in another process. the base is
+//mapped and split by csv_parser.h, and its rows are read in place; only the
+//journal's rows are copied. otherwise only stdio is used, both programs
+//include this. records are flushed to the OS, not synced; compaction syncs
+//the new base and its directory before emptying the journal, so a crash
+//cannot leave an empty journal beside a base that never reached the disk.
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <sys/stat.h>
+#include "csv_parser.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+enum TableOp { TABLE_PUT = 1, TABLE_ERASE = 2 };
+
+struct TableRecordHeader {
+    uint32_t length;     //payload bytes that follow: the row, or the key
+    uint8_t op;
+    uint8_t pad[3];
+    uint32_t check;      //over op and payload, catches torn writes
+};
+
+inline uint32_t tableRecordCheck(uint8_t op, const char* data, size_t length) {
+    //FNV-1a
+    uint32_t h = 2166136261u;
+    h = (h ^ op) * 16777619u;
+    for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char)data[i]) * 16777619u;
+    return h;
+}
+
+//first column of a row
+inline std::string_view tableKey(std::string_view row) {
+    return row.substr(0, row.find(','));
+}
+
+//the current rows of a table, as readTable() leaves them: base rows point
+//into the mapped base, journal rows into copies of their records. the rows
+//are valid until the next read or clear()
+struct TableRows {
+    CsvFile base;
+    std::deque<std::string> journal;    //a deque, so rows keep pointing at their records
+    std::vector<CsvRow> rows;
+
+    void clear() {
+        rows.clear();
+        journal.clear();
+        base.close();
+    }
+};
+
+//exclusive lock on path + ".lock" for as long as it lives
+class TableLock {
+private:
+    FILE* file;
+
+public:
+    explicit TableLock(const std::string& basePath) {
+        file = fopen((basePath + ".lock").c_str(), "ab");
+        if (!file) return;   //read-only directory: nobody can be writing either
+#ifdef _WIN32
+        OVERLAPPED ov = {0};
+        LockFileEx((HANDLE)_get_osfhandle(_fileno(file)), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+#else
+        flock(fileno(file), LOCK_EX);
+#endif
+    }
+
+    ~TableLock() {
+        if (!file) return;
+#ifdef _WIN32
+        OVERLAPPED ov = {0};
+        UnlockFileEx((HANDLE)_get_osfhandle(_fileno(file)), 0, 1, 0, &ov);
+#else
+        flock(fileno(file), LOCK_UN);
+#endif
+        fclose(file);
+    }
+};
+
+//base rows with the journal applied, in file order; no lock taken
+inline bool readTableUnlocked(const std::string& basePath, TableRows& table) {
+    table.clear();
+    std::vector<CsvRow>& rows = table.rows;
+    //keys point into the rows' text, which stays put while table lives
+    std::unordered_map<std::string_view, size_t> byKey;
+    std::vector<bool> erased;
+
+    bool haveBase = table.base.open(basePath.c_str());
+    FILE* journal = fopen((basePath + ".journal").c_str(), "rb");
+    if (!haveBase && !journal) return false;
+
+    if (haveBase) {
+        CsvParser parser(table.base.data(), table.base.size());
+        CsvRow row;
+        while (parser.nextLine(row.text)) {
+            row.line = parser.line();
+            row.offset = parser.offset();
+            rows.push_back(row);
+        }
+    }
+
+    if (journal) {
+        //the base rows are only keyed when there is a journal to apply
+        fseek(journal, 0, SEEK_END);
+        if (ftell(journal) > 0) {
+            byKey.reserve(rows.size());
+            for (size_t i = 0; i < rows.size(); i++) byKey[tableKey(rows[i].text)] = i;
+        }
+        erased.assign(rows.size(), false);
+        fseek(journal, 0, SEEK_SET);
+        TableRecordHeader h;
+        std::string payload;
+        size_t at = 0;
+        while (fread(&h, sizeof(h), 1, journal) == 1 && h.length < (1u << 20)) {
+            payload.resize(h.length);
+            if (h.length && fread(&payload[0], 1, h.length, journal) != h.length) break;
+            if (h.check != tableRecordCheck(h.op, payload.data(), payload.size())) break;
+
+            if (h.op == TABLE_PUT) {
+                table.journal.push_back(payload);
+                CsvRow row = {table.journal.back(), 0, at};
+                std::string_view key = tableKey(row.text);
+                std::unordered_map<std::string_view, size_t>::iterator it = byKey.find(key);
+                if (it != byKey.end()) {
+                    rows[it->second] = row;
+                    erased[it->second] = false;
+                } else {
+                    byKey[key] = rows.size();
+                    rows.push_back(row);
+                    erased.push_back(false);
+                }
+            } else if (h.op == TABLE_ERASE) {
+                std::unordered_map<std::string_view, size_t>::iterator it = byKey.find(payload);
+                if (it != byKey.end()) {
+                    erased[it->second] = true;
+                    byKey.erase(it);
+                }
+            }
+            at += sizeof(h) + h.length;
+        }
+        fclose(journal);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (!erased[i]) rows[kept++] = rows[i];
+        }
+        rows.resize(kept);
+    }
+    return true;
+}
+
+//the current rows of a table: base plus journal
+inline bool readTable(const std::string& basePath, TableRows& table) {
+    TableLock lock(basePath);
+    return readTableUnlocked(basePath, table);
+}
+
+//size and mtime standing for base and journal together, for caches built from
+//the table (drink_snapshot.h); false if neither file exists
+inline bool tableFingerprint(const char* basePath, uint64_t& size, int64_t& mtime) {
+    struct stat b, j;
+    bool haveBase = stat(basePath, &b) == 0;
+    bool haveJournal = stat((std::string(basePath) + ".journal").c_str(), &j) == 0;
+    if (!haveBase && !haveJournal) return false;
+    size = (haveBase ? (uint64_t)b.st_size : 0) + (haveJournal ? (uint64_t)j.st_size << 40 : 0);
+    mtime = haveBase ? (int64_t)b.st_mtime : 0;
+    if (haveJournal && (int64_t)j.st_mtime > mtime) mtime = (int64_t)j.st_mtime;
+    return true;
+}
+
+class TableJournal {
+private:
+    std::string basePath;
+    std::string journalPath;
+    std::thread compactor;
+    long checkedEnd;    //journal bytes already known to be whole records
+
+    //under the lock: true if everything past checkedEnd is whole records
+    bool tailIsClean() {
+        FILE* f = fopen(journalPath.c_str(), "rb");
+        if (!f) {
+            checkedEnd = 0;
+            return true;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        if (size < checkedEnd) checkedEnd = 0;   //compacted by someone else
+        fseek(f, checkedEnd, SEEK_SET);
+        TableRecordHeader h;
+        std::string payload;
+        while (checkedEnd < size && fread(&h, sizeof(h), 1, f) == 1 && h.length < (1u << 20)) {
+            payload.resize(h.length);
+            if (h.length && fread(&payload[0], 1, h.length, f) != h.length) break;
+            if (h.check != tableRecordCheck(h.op, payload.data(), payload.size())) break;
+            checkedEnd += (long)(sizeof(h) + h.length);
+        }
+        fclose(f);
+        return checkedEnd == size;
+    }
+
+    static bool syncFile(FILE* f) {
+        if (fflush(f) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    //makes a rename into the directory of path durable; on Windows the
+    //rename itself is written through
+    static bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+        (void)path;
+        return true;
+#else
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int fd = ::open(dir.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    bool compactUnlocked() {
+        TableRows table;
+        if (!readTableUnlocked(basePath, table)) return false;
+
+        std::string tmpPath = basePath + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "w");
+        if (!out) return false;
+        bool ok = true;
+        for (size_t i = 0; ok && i < table.rows.size(); i++) {
+            const std::string_view& row = table.rows[i].text;
+            ok = fwrite(row.data(), 1, row.size(), out) == row.size() && fputc('\n', out) != EOF;
+        }
+        ok = ok && syncFile(out);
+        ok = (fclose(out) == 0) && ok;
+        table.clear();   //the base cannot be replaced while it is mapped on Windows
+#ifdef _WIN32
+        ok = ok && MoveFileExA(tmpPath.c_str(), basePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        ok = ok && rename(tmpPath.c_str(), basePath.c_str()) == 0;
+#endif
+        //the journal is only emptied once the new base is on disk under its name
+        if (!ok || !syncDirectory(basePath)) {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        FILE* empty = fopen(journalPath.c_str(), "wb");
+        if (empty) fclose(empty);
+        checkedEnd = 0;
+        return true;
+    }
+
+    bool appendRecord(uint8_t op, std::string payload) {
+        if (basePath.empty()) return false;
+        while (!payload.empty() && (payload[payload.size() - 1] == '\n' || payload[payload.size() - 1] == '\r')) {
+            payload.erase(payload.size() - 1);
+        }
+        TableRecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.length = (uint32_t)payload.size();
+        h.op = op;
+        h.check = tableRecordCheck(op, payload.data(), payload.size());
+
+        bool ok;
+        {
+            TableLock lock(basePath);
+            if (!tailIsClean() && !compactUnlocked()) return false;
+            FILE* f = fopen(journalPath.c_str(), "ab");
+            if (!f) return false;
+            ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                 fwrite(payload.data(), 1, payload.size(), f) == payload.size();
+            ok = (fclose(f) == 0) && ok;
+            if (ok) checkedEnd += (long)(sizeof(h) + payload.size());
+        }
+        if (ok && compactDue()) compactInBackground();
+        return ok;
+    }
+
+public:
+    TableJournal() : checkedEnd(0) {}
+
+    ~TableJournal() {
+        close();
+    }
+
+    void open(const char* base) {
+        close();
+        basePath = base;
+        journalPath = basePath + ".journal";
+        checkedEnd = 0;
+    }
+
+    //waits for a compaction still running
+    void close() {
+        if (compactor.joinable()) compactor.join();
+    }
+
+    //adds the row, or replaces the row with the same first column
+    bool put(const std::string& row) {
+        return appendRecord(TABLE_PUT, row);
+    }
+
+    bool erase(const std::string& key) {
+        return appendRecord(TABLE_ERASE, key);
+    }
+
+    bool read(TableRows& table) const {
+        return readTable(basePath, table);
+    }
+
+    //once the journal is half the size of the base, so rewriting the base
+    //costs about as much as the edits that led to it
+    bool compactDue() const {
+        struct stat b, j;
+        if (stat(journalPath.c_str(), &j) != 0 || j.st_size < 4096) return false;
+        return stat(basePath.c_str(), &b) != 0 || j.st_size * 2 >= b.st_size;
+    }
+
+    //folds the journal into the base and empties it
+    bool compact() {
+        if (basePath.empty()) return false;
+        TableLock lock(basePath);
+        return compactUnlocked();
+    }
+
+    //compacts on a worker thread; a compaction already running is waited for first
+    void compactInBackground() {
+        if (compactor.joinable()) compactor.join();
+        compactor = std::thread([this] { compact(); });
+    }
+};
+
+#endif